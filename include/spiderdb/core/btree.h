@@ -19,12 +19,13 @@ public:
     seastar::future<> write(seastar::temporary_buffer<char> buffer) override;
     seastar::future<> read(seastar::temporary_buffer<char> buffer) override;
     static constexpr size_t size() noexcept {
-        return file_header::size() + sizeof(_root);
+        return file_header::size() + sizeof(_root) + sizeof(_node_page_size);
     }
     friend btree_impl;
 
 protected:
     node_id _root = root_node;
+    uint32_t _node_page_size = 0;
 };
 
 struct btree_impl : file_impl, seastar::weakly_referencable<btree_impl> {
@@ -39,9 +40,15 @@ public:
     seastar::future<> add(string&& key, value_pointer ptr);
     seastar::future<value_pointer> remove(string&& key);
     seastar::future<value_pointer> find(string&& key);
-    seastar::future<node> create_node(node_type type, seastar::weak_ptr<node_impl>&& parent = nullptr);
-    seastar::future<node> get_node(node_id id, seastar::weak_ptr<node_impl>&& parent = nullptr);
+    seastar::future<node> create_node(node_type type);
+    seastar::future<node> get_node(node_id id, bool is_access = true);
     seastar::future<> cache_node(node node);
+    uint64_t get_pinned_bytes() const noexcept;
+    uint64_t get_loaded_node_count() const noexcept;
+    void on_leaf_access(const node& leaf);
+    void start_sequential_scan() noexcept;
+    void stop_sequential_scan() noexcept;
+    void start_warm_up();
     virtual void log() const noexcept override;
     virtual bool is_open() const noexcept override;
     friend btree;
@@ -49,18 +56,46 @@ public:
 protected:
     seastar::shared_ptr<file_header> get_new_file_header() override;
     seastar::shared_ptr<page_header> get_new_page_header() override;
+    seastar::future<> check_header() override;
+    seastar::future<> checkpoint() override;
+    virtual seastar::future<> read_ahead_values(node leaf);
+    virtual void get_warm_pages(std::vector<std::pair<page_id, page_type>>& pages) const;
+    virtual seastar::future<> warm_up_page(page_id id, page_type type);
 
 private:
     seastar::weak_ptr<btree_impl> get_pointer() noexcept;
+    seastar::future<node> load_node(node_id id);
+    void read_ahead(node_id from, uint32_t n_leaves);
+    std::string get_warm_up_file_name() const;
+    seastar::future<> save_warm_pages();
+    seastar::future<std::vector<std::pair<page_id, page_type>>> load_warm_pages();
 
 protected:
     seastar::shared_ptr<btree_header> _btree_header = nullptr;
+    seastar::semaphore _read_ahead_limit{_config.max_read_ahead_requests};
+    seastar::semaphore _warm_up_limit{_config.max_warm_up_requests};
 
 private:
     node _root;
-    std::unique_ptr<cache<node_id, node>> _cache;
+    std::unique_ptr<basic_cache<node_id, node>> _cache;
+    std::unordered_map<node_id, node> _pinned_nodes;
+    uint64_t _pinned_bytes = 0;
+    uint64_t _n_loaded_nodes = 0;
     std::unordered_map<node_id, seastar::weak_ptr<node_impl>> _nodes;
-    seastar::semaphore _get_node_lock{1};
+    std::unordered_map<node_id, seastar::shared_future<node>> _loading_nodes;
+    node_id _last_leaf = null_node;
+    node_id _last_leaf_next = null_node;
+    node_id _last_leaf_prev = null_node;
+    bool _forward = true;
+    uint32_t _sequential_run = 0;
+    uint32_t _sequential_scans = 0;
+    uint32_t _read_ahead_window = 0;
+    uint32_t _read_ahead_distance = 0;
+    node_id _read_ahead_frontier = null_node;
+    bool _reading_ahead = false;
+    seastar::future<> _read_ahead = seastar::make_ready_future<>();
+    bool _warming_up = false;
+    seastar::future<> _warm_up = seastar::make_ready_future<>();
 };
 
 struct btree {
@@ -78,6 +113,9 @@ public:
     seastar::future<> add(string&& key, value_pointer ptr) const;
     seastar::future<value_pointer> remove(string&& key) const;
     seastar::future<value_pointer> find(string&& key) const;
+    void start_sequential_scan() const;
+    void stop_sequential_scan() const;
+    uint64_t get_loaded_node_count() const;
     void log() const;
 
 private:
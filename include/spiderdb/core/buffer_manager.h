@@ -0,0 +1,62 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#pragma once
+
+#include <spiderdb/core/page.h>
+#include <spiderdb/core/config.h>
+#include <seastar/core/future.hh>
+#include <seastar/core/memory.hh>
+#include <seastar/core/condition-variable.hh>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace spiderdb {
+
+struct buffer_manager {
+public:
+    // Evicts one item and resolves to false once there is nothing left to evict
+    using shrinker = std::function<seastar::future<bool>()>;
+    buffer_manager() = delete;
+    buffer_manager(const spiderdb_config& config, page_frame_arena& arena);
+    ~buffer_manager() = default;
+    void start();
+    seastar::future<> stop();
+    void add_shrinker(shrinker shrinker);
+    void add_dirty_bytes(uint64_t bytes) noexcept;
+    void remove_dirty_bytes(uint64_t bytes) noexcept;
+    void add_pinned_bytes(uint64_t bytes) noexcept;
+    void remove_pinned_bytes(uint64_t bytes) noexcept;
+    void check_budget() noexcept;
+    uint64_t get_budget() const noexcept;
+    uint64_t get_resident_bytes() const noexcept;
+    uint64_t get_dirty_bytes() const noexcept;
+    bool is_over_budget() const noexcept;
+    void log() const noexcept;
+
+private:
+    seastar::memory::reclaiming_result reclaim(seastar::memory::reclaimer::request request);
+    void adjust_budget() noexcept;
+    uint64_t get_min_budget() const noexcept;
+    void resume_shrinking() noexcept;
+    seastar::future<> shrink();
+
+private:
+    const spiderdb_config& _config;
+    page_frame_arena& _arena;
+    uint64_t _budget = 0;
+    uint64_t _dirty_bytes = 0;
+    uint64_t _pinned_bytes = 0;
+    std::vector<shrinker> _shrinkers;
+    size_t _next_shrinker = 0;
+    std::unique_ptr<seastar::memory::reclaimer> _reclaimer;
+    seastar::future<> _shrinking = seastar::make_ready_future<>();
+    seastar::condition_variable _shrink_cond;
+    // Set when a pass found nothing to evict, until pages are cleaned or unpinned or the budget interval passes
+    bool _shrink_stalled = false;
+    bool _stopped = true;
+};
+
+}
@@ -4,31 +4,87 @@
 
 #pragma once
 
+#include <spiderdb/util/cache.h>
 #include <seastar/util/log.hh>
+#include <seastar/core/file.hh>
+#include <seastar/core/scheduling.hh>
+#include <chrono>
 
 namespace spiderdb {
 
+enum struct durability : uint8_t {
+    // Acknowledged once applied to the cache
+    in_memory = 0,
+    // Acknowledged once written to the file
+    buffered = 1,
+    // Acknowledged once written to the file and synced to the device
+    synced = 2
+};
+
 namespace internal {
 
 struct file_config {
     uint16_t file_header_size = 1 << 12;
     uint16_t page_header_size = 1 << 7;
+    // Allocation unit of the file, node and data pages span a whole number of units
     uint32_t page_size = 1 << 14;
+    uint32_t page_frame_alignment = 1 << 12;
+    uint32_t n_free_page_frames = 1 << 8;
+    // Bytes of page frames held by a shard, adjusted between the bounds as free memory changes
+    uint64_t buffer_budget = 1 << 26;
+    uint64_t min_buffer_budget = 1 << 24;
+    uint64_t max_buffer_budget = 1ull << 32;
+    double max_free_memory_ratio = 0.5;
+    std::chrono::milliseconds buffer_budget_interval{1000};
+    uint32_t file_growth_chunk_pages = 1 << 8;
+    bool punch_free_tail = false;
+    double dirty_ratio = 0.1;
+    double max_dirty_ratio = 0.2;
+    uint32_t max_pages_per_writeback = 1 << 8;
+    // Writeback passes that may fail in a row before the error is returned, each one waiting twice as long as the last
+    uint32_t max_writeback_retries = 1 << 2;
+    std::chrono::milliseconds writeback_retry_delay{10};
+    std::chrono::milliseconds writeback_interval{1000};
+    seastar::scheduling_group writeback_scheduling_group = seastar::default_scheduling_group();
+    seastar::io_priority_class writeback_priority_class = seastar::default_priority_class();
+    durability default_durability = durability::in_memory;
+    std::chrono::microseconds group_commit_window{200};
     seastar::log_level log_level = seastar::log_level::info;
 };
 
 struct btree_config {
+    uint32_t node_page_size = 1 << 14;
     uint32_t max_keys_on_each_node = 1 << 12;
     uint32_t min_keys_on_each_node = 1 << 4;
     uint32_t n_cached_nodes = 1 << 8;
+    cache_policy node_cache_policy = cache_policy::lru;
+    // Keep internal nodes resident outside the node cache, up to the given bytes
+    bool pin_internal_nodes = false;
+    uint64_t max_pinned_node_bytes = 1 << 26;
+    uint32_t read_ahead_trigger = 2;
+    uint32_t max_read_ahead_leaves = 1 << 4;
+    uint32_t max_read_ahead_requests = 1 << 5;
+    // Preload the nodes and data pages that were resident at the last close
+    bool warm_up_on_open = false;
+    uint32_t max_warm_up_requests = 1 << 4;
     bool enable_logging_node_detail = false;
 };
 
 struct storage_config {
+    uint32_t data_page_size = 1 << 14;
     uint64_t max_empty_values_on_each_page = 1 << 8;
     uint64_t max_available_pages = 1 << 8;
     uint32_t min_available_space = 1 << 7;
     uint32_t n_cached_data_pages = 1 << 8;
+    cache_policy data_page_cache_policy = cache_policy::lru;
+    // Bytes of hot key-value pairs kept in front of the B-Tree, disabled when zero
+    uint64_t value_cache_size = 0;
+    uint32_t max_cached_value_size = 1 << 12;
+    // Bloom filter bits per key for short-circuiting lookups of absent keys, disabled when zero
+    uint32_t bloom_filter_bits_per_key = 0;
+    uint64_t min_bloom_filter_keys = 1 << 16;
+    uint32_t wal_buffer_size = 1 << 20;
+    uint64_t max_wal_segment_size = 1 << 26;
     bool enable_logging_data_page_detail = false;
 };
 
@@ -5,16 +5,40 @@
 #pragma once
 
 #include <spiderdb/core/page.h>
+#include <spiderdb/core/buffer_manager.h>
 #include <spiderdb/core/config.h>
 #include <seastar/core/file.hh>
 #include <seastar/core/semaphore.hh>
+#include <seastar/core/condition-variable.hh>
+#include <seastar/core/shared_future.hh>
 #include <chrono>
+#include <map>
 
 namespace spiderdb {
 
 struct file_impl;
 struct file;
 
+struct free_space_map {
+public:
+    free_space_map() = default;
+    ~free_space_map() = default;
+    void release(page_id first, uint64_t count);
+    page_id allocate(uint64_t count);
+    seastar::future<> write(seastar::temporary_buffer<char> buffer);
+    seastar::future<> read(seastar::temporary_buffer<char> buffer);
+    size_t size() const noexcept;
+    uint64_t get_free_page_count() const noexcept;
+    page_id get_free_tail(uint64_t page_count) const noexcept;
+    bool is_dirty() const noexcept;
+    void mark_clean() noexcept;
+
+private:
+    std::map<page_id::underlying_type, uint64_t> _extents;
+    uint64_t _free_page_count = 0;
+    bool _dirty = false;
+};
+
 struct file_header {
 public:
     seastar::future<> flush(seastar::file file);
@@ -22,19 +46,30 @@ public:
     virtual seastar::future<> write(seastar::temporary_buffer<char> buffer);
     virtual seastar::future<> read(seastar::temporary_buffer<char> buffer);
     static constexpr size_t size() noexcept {
-        return sizeof(_page_size) + sizeof(_page_count) + sizeof(_first_free_page) + sizeof(_last_free_page);
+        return sizeof(_format_version) + sizeof(_page_size) + sizeof(_page_count) + sizeof(_free_space_page) +
+               sizeof(_free_space_page_count);
+    }
+    // Bumped whenever the layout of the headers or of the pages changes
+    static constexpr uint32_t format_version() noexcept {
+        return 1;
     }
     friend file_impl;
 
 protected:
     uint16_t _size = 0;
+    uint32_t _format_version = 0;
     uint32_t _page_size = 0;
     uint64_t _page_count = 0;
-    page_id _first_free_page = null_page;
-    page_id _last_free_page = null_page;
+    page_id _free_space_page = null_page;
+    uint64_t _free_space_page_count = 0;
     bool _dirty = true;
 };
 
+struct commit_batch {
+    durability _level = durability::buffered;
+    seastar::shared_promise<> _done;
+};
+
 struct file_impl : seastar::weakly_referencable<file_impl> {
 public:
     file_impl() = delete;
@@ -43,35 +78,87 @@ public:
     virtual seastar::future<> open();
     virtual seastar::future<> flush();
     virtual seastar::future<> close();
+    virtual seastar::future<> commit(durability level);
     seastar::future<page_id> write(string data);
     seastar::future<> write(page_id id, string data);
     seastar::future<string> read(page_id id);
     seastar::future<> unlink_pages_from(page_id id);
     seastar::future<> write(page first, string data);
+    seastar::future<> write(page first, uint32_t len, std::function<void(char*)> encode);
     seastar::future<string> read(page first);
     seastar::future<> unlink_pages_from(page first);
     virtual void log() const noexcept;
     virtual bool is_open() const noexcept;
+    const std::string& get_name() const noexcept;
+    uint64_t get_resident_bytes() const noexcept;
+    uint64_t get_dirty_bytes() const noexcept;
     friend file;
 
 protected:
     virtual seastar::shared_ptr<file_header> get_new_file_header();
     virtual seastar::shared_ptr<page_header> get_new_page_header();
-    seastar::future<page> get_free_page();
-    seastar::future<page> get_or_create_page(page_id id);
+    virtual seastar::future<> check_header();
+    virtual seastar::future<> checkpoint();
+    virtual seastar::future<> sync_log(uint64_t lsn);
+    seastar::future<page> get_free_page(uint32_t page_size);
+    seastar::future<page> get_or_create_page(page_id id, uint32_t page_size);
+    page create_page(page_id id, uint32_t page_size);
+    void add_page(const page& new_page);
+    seastar::future<> write_pages(page first, page_id next, string data);
+    page_id allocate_pages(uint64_t count);
+    void release_pages(page_id first, uint64_t count);
+    page_id grow(uint64_t count);
+    seastar::future<> preallocate();
+    seastar::future<> punch_free_tail();
+    uint64_t get_page_span(uint32_t page_size) const noexcept;
+    bool is_valid_page_size(uint32_t page_size) const noexcept;
+    uint64_t get_overflow_page_count(uint32_t record_len, uint32_t page_size) const noexcept;
+    seastar::future<> load_free_space_map();
+    seastar::future<> flush_free_space_map();
+    seastar::future<> mark_page_dirty(page dirty_page);
+    seastar::future<> throttle_writes();
+    void discard_dirty_pages(page_id first, uint64_t count);
+    void start_writeback();
+    seastar::future<> stop_writeback();
+    seastar::future<> write_back(uint64_t max_dirty_bytes);
+    seastar::future<> write_dirty_pages(std::vector<page> pages);
+    uint64_t get_dirty_threshold() const noexcept;
+    std::string get_double_write_file_name() const;
+    seastar::future<> write_double_write_buffer();
+    seastar::future<> recover_double_write_buffer();
+    seastar::future<> remove_double_write_buffer();
 
 public:
     spiderdb_config _config;
 
 protected:
     seastar::shared_ptr<file_header> _file_header = nullptr;
+    buffer_manager _buffer_manager{_config, _page_frame_arena};
+    uint64_t _lsn = 0;
+    bool _created = false;
+    // Set by files recovered from a log, whose pages only reach the disk with a checkpoint, so that the log is always
+    // replayed against the state of the last one
+    bool _no_steal = false;
 
 private:
     const std::string _name;
     seastar::file _file;
     std::unordered_map<page_id, seastar::weak_ptr<page_impl>> _pages;
+    size_t _page_sweep_threshold = 1 << 10;
+    page_frame_arena _page_frame_arena;
+    free_space_map _free_space_map;
+    std::vector<std::pair<uint64_t, uint64_t>> _preallocations;
+    uint64_t _punched_tail = 0;
+    std::map<page_id, page> _dirty_pages;
+    page_id _writeback_cursor = null_page;
+    seastar::future<> _writeback = seastar::make_ready_future<>();
+    seastar::condition_variable _writeback_cond;
+    seastar::condition_variable _writeback_done;
+    seastar::semaphore _writeback_lock{1};
+    bool _writeback_stopped = true;
+    seastar::lw_shared_ptr<commit_batch> _commit_batch = nullptr;
+    seastar::semaphore _commit_lock{1};
     seastar::semaphore _file_lock{1};
-    seastar::semaphore _get_free_page_lock{1};
 };
 
 struct file {
@@ -88,6 +175,7 @@ public:
     seastar::future<> close() const;
     seastar::future<page_id> write(string data) const;
     seastar::future<string> read(page_id id) const;
+    seastar::future<> unlink(page_id id) const;
     void log() const;
 
 private:
@@ -12,19 +12,22 @@ struct node_impl;
 struct node;
 struct btree_impl;
 
+// Ancestors of a node from the root down to its parent, recorded by the writer on its way down. Parents are not
+// stored in the nodes, so splits and merges climb this path instead.
+using node_path = std::vector<node>;
+
 struct node_header : page_header {
 public:
     seastar::future<> write(seastar::temporary_buffer<char> buffer) override;
     seastar::future<> read(seastar::temporary_buffer<char> buffer) override;
     void log() const noexcept override;
     static constexpr size_t size() noexcept {
-        return page_header::size() + sizeof(_parent) + sizeof(_key_count) + sizeof(_prefix_len);
+        return page_header::size() + sizeof(_key_count) + sizeof(_prefix_len);
     }
     friend node_impl;
     friend node;
 
 private:
-    node_id _parent = null_node;
     uint32_t _key_count = 0;
     uint32_t _prefix_len = 0;
 };
@@ -32,37 +35,45 @@ private:
 struct node_impl : seastar::enable_lw_shared_from_this<node_impl>, seastar::weakly_referencable<node_impl> {
 public:
     node_impl() = delete;
-    node_impl(page page, seastar::weak_ptr<btree_impl>&& btree, seastar::weak_ptr<node_impl>&& parent);
+    node_impl(page page, seastar::weak_ptr<btree_impl>&& btree);
     ~node_impl() = default;
     seastar::future<> load();
     seastar::future<> flush();
     seastar::future<> add(string&& key, value_pointer ptr);
     seastar::future<value_pointer> remove(string&& key);
     seastar::future<value_pointer> find(string&& key);
-    seastar::future<node> get_parent();
     seastar::future<node> get_child(uint32_t id);
-    void update_parent(seastar::weak_ptr<node_impl>&& parent) noexcept;
     int64_t binary_search(const string& key, int64_t low, int64_t high);
-    seastar::future<> split();
+    seastar::future<> split(node_path&& path);
     bool need_split() noexcept;
-    seastar::future<> promote(string&& promoted_key, node_id left_child, node_id right_child);
-    seastar::future<> merge();
+    seastar::future<> promote(string&& promoted_key, node_id left_child, node_id right_child, node_path&& path);
+    seastar::future<> merge(node_path&& path);
     bool need_merge() noexcept;
-    seastar::future<string> demote(node_id left_child, node_id right_child);
-    seastar::future<> destroy();
+    seastar::future<string> demote(node_id left_child, node_id right_child, node_path&& path);
+    seastar::future<> destroy(node_path&& path);
     bool need_destroy() noexcept;
-    seastar::future<> fire(node_id child);
+    seastar::future<> fire(node_id child, node_path&& path);
     void log() const;
     friend node;
 
 private:
+    using latch_list = std::vector<seastar::semaphore_units<>>;
+    seastar::future<> add(string&& key, value_pointer ptr, latch_list&& latches, node_path&& path);
+    seastar::future<value_pointer> remove(string&& key, latch_list&& latches, node_path&& path);
+    bool is_safe_for_add(const string& key);
+    bool is_safe_for_remove(const string& key);
     seastar::future<node> create_node(std::vector<string>&& keys, std::vector<node_item_pointer>&& pointers);
     seastar::future<> link_siblings(node left, node right);
     seastar::future<> cache(node node);
-    seastar::future<> become_parent();
     void update_data(std::vector<string>&& keys, std::vector<node_item_pointer>&& pointers);
     void update_metadata();
     void calculate_data_length() noexcept;
+    void update_heads();
+    void encode(char* data) const;
+    void decode(const char* data);
+    static constexpr size_t slot_size() noexcept {
+        return sizeof(uint32_t) + sizeof(uint32_t);
+    }
     seastar::future<> clean();
     bool is_valid() const noexcept;
 
@@ -71,15 +82,25 @@ private:
     page _page;
     seastar::weak_ptr<btree_impl> _btree;
     seastar::shared_ptr<node_header> _header;
+    // Decoded from the slotted layout in the page frame on load and encoded back on flush. Search, insert and delete
+    // work on these rather than on the frame.
     std::vector<string> _keys;
     std::vector<node_item_pointer> _pointers;
-    seastar::weak_ptr<node_impl> _parent;
+    // Big-endian first bytes of each key after the prefix, searched before the keys
+    std::vector<uint64_t> _heads;
+    // Length shared by every key if their heads hold them whole, as with fixed-width integer keys, otherwise 0
+    size_t _fixed_key_len = 0;
+    // Resident children by slot, checked against the child ids in _pointers
+    std::vector<seastar::weak_ptr<node_impl>> _children;
     node_id _next = null_node;
     node_id _prev = null_node;
     string _prefix;
     string _high_key;
     size_t _data_len = 0;
     seastar::semaphore _lock{1};
+    // Bumped whenever the keys, the pointers or the links change, so that readers can detect a concurrent write
+    uint64_t _version = 0;
+    bool _cleaned = false;
     bool _loaded = false;
     bool _dirty = false;
 };
@@ -87,7 +108,7 @@ private:
 struct node {
 public:
     node() = default;
-    node(page page, seastar::weak_ptr<btree_impl>&& btree, seastar::weak_ptr<node_impl>&& parent = nullptr);
+    node(page page, seastar::weak_ptr<btree_impl>&& btree);
     node(seastar::lw_shared_ptr<node_impl> impl);
     ~node() = default;
     node(const node& other_node);
@@ -103,7 +124,6 @@ public:
     page get_page() const;
     const std::vector<string>& get_key_list() const;
     const std::vector<node_item_pointer>& get_pointer_list() const;
-    node_id get_parent_node() const;
     node_id get_next_node() const;
     node_id get_prev_node() const;
     const string& get_high_key() const;
@@ -118,18 +138,16 @@ public:
     seastar::future<> add(string&& key, value_pointer ptr) const;
     seastar::future<value_pointer> remove(string&& key) const;
     seastar::future<value_pointer> find(string&& key) const;
-    void update_parent(seastar::weak_ptr<node_impl>&& parent) const;
     int64_t binary_search(const string& key, int64_t low, int64_t high) const;
-    seastar::future<> split() const;
+    seastar::future<> split(node_path&& path) const;
     bool need_split() const;
-    seastar::future<> promote(string&& key, node_id left_child, node_id right_child) const;
-    seastar::future<> merge() const;
+    seastar::future<> promote(string&& key, node_id left_child, node_id right_child, node_path&& path) const;
+    seastar::future<> merge(node_path&& path) const;
     bool need_merge() const;
-    seastar::future<string> demote(node_id left_child, node_id right_child) const;
-    seastar::future<> destroy() const;
+    seastar::future<string> demote(node_id left_child, node_id right_child, node_path&& path) const;
+    seastar::future<> destroy(node_path&& path) const;
     bool need_destroy() const;
-    seastar::future<> fire(node_id child) const;
-    seastar::future<> become_parent() const;
+    seastar::future<> fire(node_id child, node_path&& path) const;
     void update_data(std::vector<string>&& keys, std::vector<node_item_pointer>&& pointers) const;
     void update_metadata() const;
     seastar::future<> clean() const;
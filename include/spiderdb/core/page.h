@@ -15,19 +15,40 @@
 #include <seastar/core/semaphore.hh>
 #include <seastar/core/rwlock.hh>
 #include <seastar/core/file.hh>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 namespace spiderdb {
 
+struct page_frame_arena;
 struct page_impl;
 struct page;
 
+struct page_frame_arena : seastar::weakly_referencable<page_frame_arena> {
+public:
+    page_frame_arena() = delete;
+    page_frame_arena(const spiderdb_config& config);
+    ~page_frame_arena() = default;
+    seastar::temporary_buffer<char> allocate(uint32_t size);
+    void release(seastar::temporary_buffer<char>&& frame);
+    uint64_t trim() noexcept;
+    size_t size() const noexcept;
+    uint64_t get_resident_bytes() const noexcept;
+
+private:
+    const spiderdb_config& _config;
+    std::unordered_map<uint32_t, std::vector<seastar::temporary_buffer<char>>> _free_frames;
+    uint64_t _resident_bytes = 0;
+};
+
 struct page_header {
 public:
     virtual seastar::future<> write(seastar::temporary_buffer<char> buffer);
     virtual seastar::future<> read(seastar::temporary_buffer<char> buffer);
     virtual void log() const noexcept;
     static constexpr size_t size() noexcept {
-        return sizeof(_type) + sizeof(_data_len) + sizeof(_record_len) + sizeof(_next);
+        return sizeof(_type) + sizeof(_data_len) + sizeof(_record_len) + sizeof(_next) + sizeof(_lsn);
     }
     friend page_impl;
     friend page;
@@ -37,17 +58,23 @@ protected:
     uint32_t _data_len = 0;
     uint32_t _record_len = 0;
     page_id _next = null_page;
+    uint64_t _lsn = 0;
 };
 
 struct page_impl : seastar::enable_lw_shared_from_this<page_impl>, seastar::weakly_referencable<page_impl> {
 public:
     page_impl() = delete;
-    page_impl(page_id id, const spiderdb_config& config);
-    ~page_impl() = default;
+    page_impl(page_id id, uint32_t size, const spiderdb_config& config, seastar::weak_ptr<page_frame_arena>&& arena);
+    ~page_impl();
+    uint32_t get_size() const noexcept;
     uint32_t get_work_size() const noexcept;
+    uint64_t get_offset() const noexcept;
     seastar::future<> load(seastar::file file);
     seastar::future<> flush(seastar::file file);
+    seastar::future<> seal();
+    seastar::future<seastar::temporary_buffer<char>> snapshot();
     seastar::future<> write(seastar::simple_memory_input_stream& is);
+    seastar::future<> write(uint32_t len, std::function<void(char*)> encode);
     seastar::future<> read(seastar::simple_memory_output_stream& os);
     void log() const noexcept;
     friend page;
@@ -57,9 +84,11 @@ private:
 
 private:
     const page_id _id = null_page;
+    const uint32_t _size = 0;
     const spiderdb_config& _config;
+    seastar::weak_ptr<page_frame_arena> _arena;
     seastar::shared_ptr<page_header> _header = nullptr;
-    string _data;
+    seastar::temporary_buffer<char> _data;
     seastar::semaphore _lock{1};
     seastar::rwlock _rwlock;
 };
@@ -67,7 +96,7 @@ private:
 struct page {
 public:
     page() = delete;
-    page(page_id id, const spiderdb_config& config);
+    page(page_id id, uint32_t size, const spiderdb_config& config, seastar::weak_ptr<page_frame_arena>&& arena = nullptr);
     page(seastar::lw_shared_ptr<page_impl> impl);
     ~page() = default;
     page(const page& other_page);
@@ -79,19 +108,27 @@ public:
     page_id get_id() const;
     seastar::weak_ptr<page_impl> get_pointer() const;
     seastar::shared_ptr<page_header> get_header() const;
+    uint32_t get_size() const;
     uint32_t get_work_size() const;
+    uint64_t get_offset() const;
+    seastar::temporary_buffer<char> get_frame() const;
     uint32_t get_record_length() const;
     page_id get_next_page() const;
     page_type get_type() const;
+    uint64_t get_lsn() const;
     void set_header(seastar::shared_ptr<page_header> header);
     void set_record_length(uint32_t record_len);
     void set_next_page(page_id next);
     void set_type(page_type type);
+    void set_lsn(uint64_t lsn);
 
     // APIs
     seastar::future<> load(seastar::file file);
     seastar::future<> flush(seastar::file file);
+    seastar::future<> seal();
+    seastar::future<seastar::temporary_buffer<char>> snapshot();
     seastar::future<> write(seastar::simple_memory_input_stream& is);
+    seastar::future<> write(uint32_t len, std::function<void(char*)> encode);
     seastar::future<> read(seastar::simple_memory_output_stream& os);
     void log() const;
 
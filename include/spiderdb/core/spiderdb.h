@@ -9,8 +9,26 @@
 
 namespace spiderdb {
 
+struct spiderdb_impl;
 struct spiderdb;
 
+struct manifest {
+public:
+    seastar::future<> flush(seastar::file file);
+    seastar::future<> load(seastar::file file);
+    seastar::future<> write(seastar::temporary_buffer<char> buffer);
+    seastar::future<> read(seastar::temporary_buffer<char> buffer);
+    static constexpr size_t size() noexcept {
+        return sizeof(_shard_count) + sizeof(_hasher_id);
+    }
+    friend spiderdb_impl;
+
+private:
+    uint16_t _size = 0;
+    uint32_t _shard_count = 0;
+    uint32_t _hasher_id = 0;
+};
+
 struct spiderdb_impl {
 public:
     spiderdb_impl() = delete;
@@ -19,16 +37,23 @@ public:
     seastar::future<> open();
     seastar::future<> flush();
     seastar::future<> close();
-    seastar::future<> insert(string&& key, string&& value);
-    seastar::future<> update(string&& key, string&& value);
-    seastar::future<> erase(string&& key);
+    seastar::future<> insert(string&& key, string&& value, durability level);
+    seastar::future<> update(string&& key, string&& value, durability level);
+    seastar::future<> erase(string&& key, durability level);
     seastar::future<string> select(string&& key);
     bool is_open() const noexcept;
     friend struct spiderdb;
 
+private:
+    seastar::future<> open_manifest();
+    std::string get_manifest_name() const;
+    std::string get_shard_name(unsigned shard) const;
+    unsigned get_shard(const string& key) const;
+
 private:
     std::string _name;
     spiderdb_config _config;
+    manifest _manifest;
     seastar::distributed<storage_impl> _storage;
 };
 
@@ -45,8 +70,11 @@ public:
     seastar::future<> open() const;
     seastar::future<> close() const;
     seastar::future<> insert(string&& key, string&& value) const;
+    seastar::future<> insert(string&& key, string&& value, durability level) const;
     seastar::future<> update(string&& key, string&& value) const;
+    seastar::future<> update(string&& key, string&& value, durability level) const;
     seastar::future<> erase(string&& key) const;
+    seastar::future<> erase(string&& key, durability level) const;
     seastar::future<string> select(string&& key) const;
 
 private:
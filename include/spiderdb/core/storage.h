@@ -6,8 +6,14 @@
 
 #include <spiderdb/core/data_page.h>
 #include <spiderdb/core/btree.h>
+#include <spiderdb/core/wal.h>
 #include <spiderdb/util/cache.h>
 #include <seastar/core/shared_future.hh>
+#include <seastar/core/rwlock.hh>
+#include <deque>
+#include <list>
+#include <optional>
+#include <string_view>
 
 namespace spiderdb {
 
@@ -33,6 +39,55 @@ private:
     std::unordered_map<page_id, uint32_t> _available_pages;
 };
 
+struct value_cache {
+public:
+    value_cache() = delete;
+    value_cache(uint64_t capacity, uint32_t max_value_size);
+    ~value_cache() = default;
+    std::optional<string> get(const string& key);
+    void put(const string& key, const string& value);
+    bool contains(const string& key) const;
+    void erase(const string& key);
+    void clear() noexcept;
+    uint64_t get_size() const noexcept;
+    size_t get_count() const noexcept;
+
+private:
+    static std::string_view get_view(const string& key) noexcept;
+    static uint64_t get_entry_size(const string& key, const string& value) noexcept;
+
+private:
+    const uint64_t _capacity = 0;
+    const uint32_t _max_value_size = 0;
+    uint64_t _size = 0;
+    std::list<std::pair<string, string>> _entries;
+    std::unordered_map<std::string_view, std::list<std::pair<string, string>>::iterator> _index;
+};
+
+struct bloom_filter {
+public:
+    bloom_filter() = default;
+    bloom_filter(uint64_t capacity, uint32_t bits_per_key);
+    ~bloom_filter() = default;
+    static uint64_t get_hash(const string& key) noexcept;
+    void add(uint64_t hash) noexcept;
+    bool may_contain(uint64_t hash) const noexcept;
+    void mark_erased() noexcept;
+    bool need_rebuild() const noexcept;
+    seastar::future<> write(seastar::temporary_buffer<char> buffer);
+    seastar::future<> read(seastar::temporary_buffer<char> buffer);
+    size_t size() const noexcept;
+    bool empty() const noexcept;
+    uint64_t get_key_count() const noexcept;
+
+private:
+    uint64_t _capacity = 0;
+    uint32_t _n_hashes = 0;
+    uint64_t _n_keys = 0;
+    uint64_t _n_erased = 0;
+    std::vector<uint64_t> _bits;
+};
+
 struct storage_header : btree_header {
 public:
     seastar::future<> write(seastar::temporary_buffer<char> buffer) override;
@@ -40,6 +95,11 @@ public:
     friend storage_impl;
 
 private:
+    uint64_t _wal_segment = 0;
+    uint64_t _redo_lsn = 0;
+    uint32_t _data_page_size = 0;
+    page_id _filter_page = null_page;
+    uint64_t _filter_checksum = 0;
     std::unique_ptr<available_page_list> _available_page_list;
 };
 
@@ -51,10 +111,11 @@ public:
     seastar::future<> open() override;
     seastar::future<> flush() override;
     seastar::future<> close() override;
-    seastar::future<> insert(string&& key, string&& value);
-    seastar::future<> update(string&& key, string&& value);
-    seastar::future<> erase(string&& key);
+    seastar::future<> insert(string&& key, string&& value, durability level);
+    seastar::future<> update(string&& key, string&& value, durability level);
+    seastar::future<> erase(string&& key, durability level);
     seastar::future<string> select(string&& key);
+    seastar::future<> commit(durability level) override;
     void log() const noexcept override;
     bool is_open() const noexcept override;
     friend storage;
@@ -62,6 +123,28 @@ public:
 private:
     seastar::shared_ptr<file_header> get_new_file_header() override;
     seastar::shared_ptr<page_header> get_new_page_header() override;
+    seastar::future<> check_header() override;
+    seastar::future<> checkpoint() override;
+    seastar::future<> sync_log(uint64_t lsn) override;
+    seastar::future<> read_ahead_values(node leaf) override;
+    void get_warm_pages(std::vector<std::pair<page_id, page_type>>& pages) const override;
+    seastar::future<> warm_up_page(page_id id, page_type type) override;
+    void checkpoint_wal();
+    seastar::future<> redo(wal_record record);
+    seastar::future<> log_and_apply(wal_operation operation, string&& key, string&& value, durability level);
+    seastar::future<> validate(wal_operation operation, const string& key);
+    seastar::future<> apply(wal_operation operation, string&& key, string&& value);
+    seastar::future<> apply_insert(string&& key, string&& value);
+    seastar::future<> apply_update(string&& key, string&& value);
+    seastar::future<> apply_erase(string&& key);
+    void invalidate_value(const string& key);
+    bool may_contain(const string& key) const;
+    void add_to_filter(const string& key);
+    void remove_from_filter();
+    void rebuild_filter();
+    seastar::future<> load_filter();
+    seastar::future<page_id> write_filter();
+    seastar::future<> scan_keys();
     seastar::weak_ptr<storage_impl> get_pointer() noexcept;
     seastar::future<data_page> create_data_page();
     seastar::future<data_page> get_data_page(page_id id);
@@ -73,13 +156,31 @@ private:
     value_pointer generate_data_pointer(page_id pid, value_id vid);
     page_id get_page_id(value_pointer ptr);
     value_id get_value_id(value_pointer ptr);
+    static constexpr size_t key_lock_count() noexcept {
+        return 1 << 6;
+    }
 
 private:
     seastar::shared_ptr<storage_header> _storage_header = nullptr;
-    std::unique_ptr<cache<page_id, data_page>> _cache;
+    std::unique_ptr<basic_cache<page_id, data_page>> _cache;
     std::unordered_map<page_id, seastar::weak_ptr<data_page_impl>> _data_pages;
+    std::unordered_map<page_id, seastar::shared_future<data_page>> _loading_data_pages;
     seastar::semaphore _create_data_page_lock{1};
-    seastar::semaphore _get_data_page_lock{1};
+    std::unique_ptr<write_ahead_log> _wal;
+    std::unique_ptr<value_cache> _value_cache;
+    uint64_t _write_count = 0;
+    std::unique_ptr<bloom_filter> _filter;
+    std::vector<uint64_t> _rebuilt_filter_hashes;
+    seastar::future<> _filter_rebuild = seastar::make_ready_future<>();
+    bool _rebuilding_filter = false;
+    bool _filter_rebuild_stale = false;
+    bool _filter_dirty = false;
+    seastar::future<> _wal_checkpoint = seastar::make_ready_future<>();
+    bool _checkpointing = false;
+    // Held for read by writes and for write by checkpoints, which then only see whole operations
+    seastar::rwlock _checkpoint_lock;
+    // Writes to the same key are applied in the order they are logged
+    std::deque<seastar::semaphore> _key_locks;
 };
 
 struct storage {
@@ -95,9 +196,16 @@ public:
     seastar::future<> open() const;
     seastar::future<> close() const;
     seastar::future<> insert(string&& key, string&& value) const;
+    seastar::future<> insert(string&& key, string&& value, durability level) const;
     seastar::future<> update(string&& key, string&& value) const;
+    seastar::future<> update(string&& key, string&& value, durability level) const;
     seastar::future<> erase(string&& key) const;
+    seastar::future<> erase(string&& key, durability level) const;
     seastar::future<string> select(string&& key) const;
+    void start_sequential_scan() const;
+    void stop_sequential_scan() const;
+    uint64_t get_resident_bytes() const;
+    uint64_t get_dirty_bytes() const;
     void log() const;
 
 private:
@@ -0,0 +1,80 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#pragma once
+
+#include <spiderdb/util/string.h>
+#include <spiderdb/core/config.h>
+#include <seastar/core/future.hh>
+#include <seastar/core/file.hh>
+#include <seastar/core/semaphore.hh>
+#include <seastar/core/shared_future.hh>
+#include <seastar/core/temporary_buffer.hh>
+#include <functional>
+#include <vector>
+
+namespace spiderdb {
+
+enum struct wal_operation : uint8_t {
+    insert = 1,
+    update = 2,
+    erase = 3,
+    // Cancels the record with the LSN held in its key, whose apply failed
+    abort = 4
+};
+
+struct wal_record {
+    uint64_t _lsn = 0;
+    wal_operation _operation = wal_operation::insert;
+    string _key;
+    string _value;
+};
+
+struct write_ahead_log {
+public:
+    using redo_function = std::function<seastar::future<>(wal_record)>;
+    write_ahead_log() = delete;
+    write_ahead_log(std::string name, const spiderdb_config& config);
+    ~write_ahead_log() = default;
+    seastar::future<size_t> open(uint64_t first_segment, uint64_t redo_lsn, redo_function redo);
+    seastar::future<> close();
+    std::vector<char> prepare(wal_operation operation, const string& key, const string& value) const;
+    std::vector<char> prepare_abort(uint64_t lsn) const;
+    uint64_t append(std::vector<char>&& record);
+    seastar::future<> write(uint64_t lsn);
+    seastar::future<> sync(uint64_t lsn);
+    seastar::future<> rotate();
+    seastar::future<> remove_segments_before(uint64_t segment);
+    uint64_t get_last_lsn() const noexcept;
+    uint64_t get_segment() const noexcept;
+    uint64_t get_segment_size() const noexcept;
+    size_t get_pending_size() const noexcept;
+    void log() const noexcept;
+
+private:
+    std::string get_segment_name(uint64_t segment) const;
+    seastar::future<> open_segment(uint64_t segment);
+    seastar::future<size_t> replay_segment(uint64_t segment, redo_function& redo);
+    seastar::future<> write_pending();
+    static constexpr size_t record_header_size() noexcept {
+        return sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t);
+    }
+
+private:
+    const std::string _name;
+    const spiderdb_config& _config;
+    seastar::file _file;
+    uint64_t _first_segment = 0;
+    uint64_t _segment = 0;
+    uint64_t _segment_size = 0;
+    std::vector<char> _pending;
+    uint64_t _last_lsn = 0;
+    uint64_t _written_lsn = 0;
+    uint64_t _synced_lsn = 0;
+    seastar::lw_shared_ptr<seastar::shared_promise<>> _sync_batch = nullptr;
+    seastar::semaphore _write_lock{1};
+    seastar::semaphore _sync_lock{1};
+};
+
+}
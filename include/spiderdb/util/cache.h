@@ -9,17 +9,46 @@
 #include <seastar/core/future-util.hh>
 #include <seastar/core/shared_mutex.hh>
 #include <list>
+#include <memory>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 namespace spiderdb {
 
+enum struct cache_policy : uint8_t {
+    // Least recently used, every hit reorders the items under the lock
+    lru = 0,
+    // Small and main FIFO queues with ghost entries, hits only bump a counter
+    s3_fifo = 1
+};
+
 template <typename key_t, typename value_t>
-struct cache {
+struct basic_cache {
     static_assert(!std::is_reference_v<key_t> && !std::is_reference_v<value_t>, "Not supported");
     using key_value_pair_t = std::pair<key_t, value_t>;
-    using list_iterator_t = typename std::list<key_value_pair_t>::iterator;
     using evictor_t = std::function<seastar::future<>(const key_value_pair_t&)>;
 
+public:
+    virtual ~basic_cache() = default;
+    virtual seastar::future<> put(key_t key, value_t value) = 0;
+    virtual seastar::future<value_t> get(key_t key) = 0;
+    // Looks up a resident item without counting an access
+    virtual const value_t* peek(const key_t& key) const noexcept = 0;
+    virtual std::vector<key_value_pair_t> get_items() const = 0;
+    virtual seastar::future<> clear() noexcept = 0;
+    virtual seastar::future<bool> shrink() = 0;
+    virtual size_t size() const noexcept = 0;
+    virtual size_t capacity() const noexcept = 0;
+    virtual bool empty() const noexcept = 0;
+};
+
+template <typename key_t, typename value_t>
+struct cache : basic_cache<key_t, value_t> {
+    using key_value_pair_t = typename basic_cache<key_t, value_t>::key_value_pair_t;
+    using list_iterator_t = typename std::list<key_value_pair_t>::iterator;
+    using evictor_t = typename basic_cache<key_t, value_t>::evictor_t;
+
 public:
     cache() = delete;
 
@@ -27,7 +56,7 @@ public:
 
     ~cache() = default;
 
-    seastar::future<> put(key_t key, value_t value) {
+    seastar::future<> put(key_t key, value_t value) override {
         return seastar::with_lock(_lock, [this, key{std::move(key)}, value{std::move(value)}] {
             _items.push_front({key, value});
             auto iterator_it = _iterators.find(key);
@@ -48,7 +77,7 @@ public:
         });
     }
 
-    seastar::future<value_t> get(key_t key) {
+    seastar::future<value_t> get(key_t key) override {
         return seastar::with_lock(_lock, [this, key{std::move(key)}] {
             auto iterator_it = _iterators.find(key);
             if (iterator_it == _iterators.end()) {
@@ -59,11 +88,20 @@ public:
         });
     }
 
+    const value_t* peek(const key_t& key) const noexcept override {
+        auto iterator_it = _iterators.find(key);
+        return iterator_it != _iterators.end() ? &iterator_it->second->second : nullptr;
+    }
+
     const std::list<key_value_pair_t>& get_all_items() const noexcept {
         return _items;
     }
 
-    seastar::future<> clear() noexcept {
+    std::vector<key_value_pair_t> get_items() const override {
+        return {_items.begin(), _items.end()};
+    }
+
+    seastar::future<> clear() noexcept override {
         return seastar::with_lock(_lock, [this] {
             return seastar::do_for_each(_items.rbegin(), _items.rend(), [this](const auto& item) {
                 return _evictor(item);
@@ -74,15 +112,28 @@ public:
         });
     }
 
-    size_t size() const noexcept {
+    seastar::future<bool> shrink() override {
+        return seastar::with_lock(_lock, [this] {
+            if (_items.empty()) {
+                return seastar::make_ready_future<bool>(false);
+            }
+            return _evictor(_items.back()).then([this] {
+                _iterators.erase(_items.back().first);
+                _items.pop_back();
+                return true;
+            });
+        });
+    }
+
+    size_t size() const noexcept override {
         return _items.size();
     }
 
-    size_t capacity() const noexcept {
+    size_t capacity() const noexcept override {
         return _capacity;
     }
 
-    bool empty() const noexcept {
+    bool empty() const noexcept override {
         return _items.empty();
     }
 
@@ -94,4 +145,252 @@ private:
     seastar::shared_mutex _lock;
 };
 
+template <typename key_t, typename value_t>
+struct s3_fifo_cache : basic_cache<key_t, value_t> {
+    using key_value_pair_t = typename basic_cache<key_t, value_t>::key_value_pair_t;
+    using evictor_t = typename basic_cache<key_t, value_t>::evictor_t;
+    using slot_id_t = uint32_t;
+
+    // Items live in a fixed array of slots and the queues are rings of slot ids, so no memory is allocated once the
+    // cache is full
+    struct slot {
+        std::optional<key_value_pair_t> item;
+        uint8_t freq = 0;
+        // Set while the evictor runs, the item leaves the cache once it is done
+        bool evicting = false;
+    };
+
+    struct ring {
+        std::vector<slot_id_t> ids;
+        size_t head = 0;
+        size_t size = 0;
+
+        void push(slot_id_t id) noexcept {
+            ids[(head + size++) % ids.size()] = id;
+        }
+
+        slot_id_t pop() noexcept {
+            auto id = ids[head];
+            head = (head + 1) % ids.size();
+            --size;
+            return id;
+        }
+    };
+
+public:
+    static constexpr uint8_t max_freq = 3;
+
+    s3_fifo_cache() = delete;
+
+    s3_fifo_cache(size_t capacity, evictor_t&& evictor) : _capacity{capacity}, _evictor{std::move(evictor)} {
+        _slots.resize(_capacity);
+        _free_slots.reserve(_capacity);
+        for (size_t i = _capacity; i > 0; --i) {
+            _free_slots.push_back(static_cast<slot_id_t>(i - 1));
+        }
+        _small.ids.resize(std::max<size_t>(_capacity, 1));
+        _main.ids.resize(std::max<size_t>(_capacity, 1));
+        _ghosts.resize(std::max<size_t>(_capacity, 1));
+        _small_capacity = std::max<size_t>(_capacity / 10, 1);
+        _slot_ids.reserve(_capacity);
+        _ghost_ids.reserve(_capacity);
+    }
+
+    ~s3_fifo_cache() = default;
+
+    seastar::future<> put(key_t key, value_t value) override {
+        if (_capacity == 0) {
+            return seastar::now();
+        }
+        // Like a hit in get, a hit only bumps the frequency of the item, so it never waits for the lock
+        auto hit_it = _slot_ids.find(key);
+        if (hit_it != _slot_ids.end() && !_slots[hit_it->second].evicting) {
+            auto& slot = _slots[hit_it->second];
+            slot.item->second = std::move(value);
+            slot.freq = std::min<uint8_t>(slot.freq + 1, max_freq);
+            return seastar::now();
+        }
+        return seastar::with_lock(_lock, [this, key{std::move(key)}, value{std::move(value)}]() mutable {
+            auto slot_id_it = _slot_ids.find(key);
+            if (slot_id_it != _slot_ids.end()) {
+                auto& slot = _slots[slot_id_it->second];
+                slot.item->second = std::move(value);
+                slot.freq = std::min<uint8_t>(slot.freq + 1, max_freq);
+                return seastar::now();
+            }
+            return seastar::do_until([this] {
+                return !_free_slots.empty();
+            }, [this] {
+                return evict();
+            }).then([this, key{std::move(key)}, value{std::move(value)}]() mutable {
+                auto id = _free_slots.back();
+                _free_slots.pop_back();
+                _slots[id].item.emplace(key, std::move(value));
+                _slots[id].freq = 0;
+                _slot_ids.emplace(key, id);
+                // Items evicted recently from the small queue go straight to the main queue
+                auto ghost_it = _ghost_ids.find(key);
+                if (ghost_it != _ghost_ids.end()) {
+                    _ghost_ids.erase(ghost_it);
+                    _main.push(id);
+                } else {
+                    _small.push(id);
+                }
+            });
+        });
+    }
+
+    seastar::future<value_t> get(key_t key) override {
+        // A hit only bumps the frequency of the item, so it never waits for the lock
+        auto slot_id_it = _slot_ids.find(key);
+        if (slot_id_it == _slot_ids.end()) {
+            return seastar::make_exception_future<value_t>(cache_error{"Item not exists"});
+        }
+        auto& slot = _slots[slot_id_it->second];
+        slot.freq = std::min<uint8_t>(slot.freq + 1, max_freq);
+        return seastar::make_ready_future<value_t>(slot.item->second);
+    }
+
+    const value_t* peek(const key_t& key) const noexcept override {
+        // An item being evicted is already gone for the callers
+        auto slot_id_it = _slot_ids.find(key);
+        if (slot_id_it == _slot_ids.end() || _slots[slot_id_it->second].evicting) {
+            return nullptr;
+        }
+        return &_slots[slot_id_it->second].item->second;
+    }
+
+    std::vector<key_value_pair_t> get_items() const override {
+        std::vector<key_value_pair_t> items;
+        items.reserve(_slot_ids.size());
+        for (const auto& slot : _slots) {
+            if (slot.item) {
+                items.push_back(*slot.item);
+            }
+        }
+        return items;
+    }
+
+    seastar::future<> clear() noexcept override {
+        return seastar::with_lock(_lock, [this] {
+            return seastar::do_for_each(_slots, [this](auto& slot) {
+                if (!slot.item) {
+                    return seastar::now();
+                }
+                return _evictor(*slot.item);
+            }).then([this] {
+                _free_slots.clear();
+                for (size_t i = _capacity; i > 0; --i) {
+                    _slots[i - 1] = slot{};
+                    _free_slots.push_back(static_cast<slot_id_t>(i - 1));
+                }
+                _small.head = _small.size = 0;
+                _main.head = _main.size = 0;
+                _slot_ids.clear();
+            });
+        });
+    }
+
+    seastar::future<bool> shrink() override {
+        return seastar::with_lock(_lock, [this] {
+            if (_slot_ids.empty()) {
+                return seastar::make_ready_future<bool>(false);
+            }
+            return evict().then([] {
+                return true;
+            });
+        });
+    }
+
+    size_t size() const noexcept override {
+        return _slot_ids.size();
+    }
+
+    size_t capacity() const noexcept override {
+        return _capacity;
+    }
+
+    bool empty() const noexcept override {
+        return _slot_ids.empty();
+    }
+
+private:
+    seastar::future<> evict() {
+        std::optional<slot_id_t> victim;
+        while (!victim) {
+            if (_small.size >= _small_capacity || _main.size == 0) {
+                // Items accessed again while in the small queue are promoted, the others are evicted and remembered
+                auto id = _small.pop();
+                if (_slots[id].freq > 1) {
+                    _slots[id].freq = 0;
+                    _main.push(id);
+                } else {
+                    add_ghost(_slots[id].item->first);
+                    victim = id;
+                }
+            } else {
+                // Items accessed since the last pass get another chance
+                auto id = _main.pop();
+                if (_slots[id].freq > 0) {
+                    --_slots[id].freq;
+                    _main.push(id);
+                } else {
+                    victim = id;
+                }
+            }
+        }
+        auto id = *victim;
+        _slots[id].evicting = true;
+        return _evictor(*_slots[id].item).then([this, id] {
+            _slot_ids.erase(_slots[id].item->first);
+            _slots[id] = slot{};
+            _free_slots.push_back(id);
+        });
+    }
+
+    void add_ghost(const key_t& key) {
+        if (_ghost_count == _ghosts.size()) {
+            // Forget the oldest ghost unless the key has been remembered again since
+            auto& oldest = _ghosts[_ghost_head];
+            auto ghost_it = _ghost_ids.find(*oldest.first);
+            if (ghost_it != _ghost_ids.end() && ghost_it->second == oldest.second) {
+                _ghost_ids.erase(ghost_it);
+            }
+            _ghost_head = (_ghost_head + 1) % _ghosts.size();
+            --_ghost_count;
+        }
+        const auto seq = ++_ghost_seq;
+        _ghosts[(_ghost_head + _ghost_count++) % _ghosts.size()] = {key, seq};
+        _ghost_ids.insert_or_assign(key, seq);
+    }
+
+private:
+    const size_t _capacity;
+    size_t _small_capacity = 1;
+    std::vector<slot> _slots;
+    std::vector<slot_id_t> _free_slots;
+    std::unordered_map<key_t, slot_id_t> _slot_ids;
+    ring _small;
+    ring _main;
+    std::vector<std::pair<std::optional<key_t>, uint64_t>> _ghosts;
+    size_t _ghost_head = 0;
+    size_t _ghost_count = 0;
+    uint64_t _ghost_seq = 0;
+    std::unordered_map<key_t, uint64_t> _ghost_ids;
+    evictor_t _evictor;
+    seastar::shared_mutex _lock;
+};
+
+template <typename key_t, typename value_t>
+std::unique_ptr<basic_cache<key_t, value_t>> make_cache(cache_policy policy, size_t capacity, typename basic_cache<key_t, value_t>::evictor_t&& evictor) {
+    switch (policy) {
+        case cache_policy::s3_fifo: {
+            return std::make_unique<s3_fifo_cache<key_t, value_t>>(capacity, std::move(evictor));
+        }
+        default: {
+            return std::make_unique<cache<key_t, value_t>>(capacity, std::move(evictor));
+        }
+    }
+}
+
 }
\ No newline at end of file
@@ -122,7 +122,8 @@ enum struct page_type : uint8_t {
     internal = 1,
     leaf = 2,
     data = 3,
-    overflow = 4
+    overflow = 4,
+    free_space = 5
 };
 
 inline const char* page_type_to_string(page_type type) {
@@ -139,6 +140,9 @@ inline const char* page_type_to_string(page_type type) {
         case page_type::overflow: {
             return "overflow";
         }
+        case page_type::free_space: {
+            return "free space";
+        }
         default: {
             return "unused";
         }
@@ -13,6 +13,8 @@ namespace spiderdb {
     FUNC(page_unavailable, 100)            \
     FUNC(page_type_incorrect, 101)         \
     FUNC(file_already_opened, 200)         \
+    FUNC(manifest_mismatch, 201)           \
+    FUNC(file_format_mismatch, 202)        \
     FUNC(node_unavailable, 300)            \
     FUNC(node_exceeded_max_key_count, 301) \
     FUNC(node_child_not_exists, 302)       \
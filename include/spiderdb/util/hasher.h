@@ -8,6 +8,9 @@
 
 namespace spiderdb {
 
+// Bump whenever hasher() changes so that databases sharded with an older hash function are rejected
+constexpr uint32_t hasher_id = 1;
+
 size_t hasher(string_view str);
 
 }
@@ -0,0 +1,57 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#pragma once
+
+#include <spiderdb/util/string.h>
+#include <cstdint>
+#include <vector>
+
+namespace spiderdb {
+
+enum struct key_order : uint8_t {
+    ascending = 0,
+    descending = 1
+};
+
+// Packs typed fields into a key whose memcmp order is the order of the fields, compared one after another
+struct key_encoder {
+public:
+    key_encoder() = default;
+    ~key_encoder() = default;
+    key_encoder& add_uint64(uint64_t val, key_order order = key_order::ascending);
+    key_encoder& add_int64(int64_t val, key_order order = key_order::ascending);
+    key_encoder& add_double(double val, key_order order = key_order::ascending);
+    key_encoder& add_string(const string& val, key_order order = key_order::ascending);
+    string get() const;
+    void clear() noexcept;
+
+private:
+    void append(const char* data, size_t len, key_order order);
+
+private:
+    std::vector<char> _data;
+};
+
+// Reads the fields back in the order and with the directions they were added
+struct key_decoder {
+public:
+    key_decoder() = delete;
+    explicit key_decoder(const string& key);
+    ~key_decoder() = default;
+    uint64_t get_uint64(key_order order = key_order::ascending);
+    int64_t get_int64(key_order order = key_order::ascending);
+    double get_double(key_order order = key_order::ascending);
+    string get_string(key_order order = key_order::ascending);
+    bool empty() const noexcept;
+
+private:
+    uint64_t get_fixed(key_order order);
+
+private:
+    const string _key;
+    size_t _pos = 0;
+};
+
+}
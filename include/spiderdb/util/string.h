@@ -5,6 +5,7 @@
 #pragma once
 
 #include <seastar/core/simple-stream.hh>
+#include <cstring>
 #include <type_traits>
 
 namespace spiderdb {
@@ -137,19 +138,23 @@ public:
         return *this = *this + str;
     }
 
-    bool operator==(const basic_string<char_t>& str) const noexcept {
+    int compare(const basic_string<char_t>& str) const noexcept {
+        // Bytes are compared as unsigned, and libc's memcmp is vectorized
         if (_data == str._data) {
-            return true;
-        }
-        if (_len != str._len) {
-            return false;
+            return 0;
         }
-        for (size_t id = 0; id < _len; ++id) {
-            if (_data[id] != str._data[id]) {
-                return false;
+        const auto min_len = std::min(_len, str._len);
+        if (min_len > 0) {
+            const auto res = std::memcmp(_data, str._data, min_len);
+            if (res != 0) {
+                return res;
             }
         }
-        return true;
+        return (_len < str._len) ? -1 : (_len > str._len) ? 1 : 0;
+    }
+
+    bool operator==(const basic_string<char_t>& str) const noexcept {
+        return _len == str._len && compare(str) == 0;
     }
 
     bool operator!=(const basic_string<char_t>& str) const noexcept {
@@ -157,19 +162,7 @@ public:
     }
 
     bool operator<(const basic_string<char_t>& str) const noexcept {
-        if (_data == str._data) {
-            return false;
-        }
-        const auto min_len = std::min(_len, str._len);
-        for (size_t id = 0; id < min_len; ++id) {
-            if (_data[id] < str._data[id]) {
-                return true;
-            }
-            if (_data[id] > str._data[id]) {
-                return false;
-            }
-        }
-        return _len < str._len;
+        return compare(str) < 0;
     }
 
     bool operator>=(const basic_string<char_t>& str) const noexcept {
@@ -177,19 +170,7 @@ public:
     }
 
     bool operator>(const basic_string<char_t>& str) const noexcept {
-        if (_data == str._data) {
-            return false;
-        }
-        const auto min_len = std::min(_len, str._len);
-        for (size_t id = 0; id < min_len; ++id) {
-            if (_data[id] > str._data[id]) {
-                return true;
-            }
-            if (_data[id] < str._data[id]) {
-                return false;
-            }
-        }
-        return _len > str._len;
+        return compare(str) > 0;
     }
 
     bool operator<=(const basic_string<char_t>& str) const noexcept {
@@ -4,6 +4,8 @@
 
 #include <spiderdb/core/btree.h>
 #include <spiderdb/util/log.h>
+#include <seastar/core/seastar.hh>
+#include <algorithm>
 
 namespace spiderdb {
 
@@ -12,6 +14,8 @@ seastar::future<> btree_header::write(seastar::temporary_buffer<char> buffer) {
         buffer.trim_front(file_header::size());
         memcpy(&_root, buffer.begin(), sizeof(_root));
         buffer.trim_front(sizeof(_root));
+        memcpy(&_node_page_size, buffer.begin(), sizeof(_node_page_size));
+        buffer.trim_front(sizeof(_node_page_size));
         return seastar::now();
     });
 }
@@ -21,6 +25,8 @@ seastar::future<> btree_header::read(seastar::temporary_buffer<char> buffer) {
         buffer.trim_front(file_header::size());
         memcpy(buffer.get_write(), &_root, sizeof(_root));
         buffer.trim_front(sizeof(_root));
+        memcpy(buffer.get_write(), &_node_page_size, sizeof(_node_page_size));
+        buffer.trim_front(sizeof(_node_page_size));
         return seastar::now();
     });
 }
@@ -35,15 +41,27 @@ seastar::future<> btree_impl::open() {
     if (is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::file_already_opened});
     }
+    if (!is_valid_page_size(_config.node_page_size)) {
+        return seastar::make_exception_future<>(std::invalid_argument("Node page size is not a multiple of the page size"));
+    }
     return file_impl::open().then([this] {
         _btree_header = seastar::dynamic_pointer_cast<btree_header>(_file_header);
+        // Nodes keep the size they were created with, which an existing file checks while it is opened
+        if (_created) {
+            _btree_header->_node_page_size = _config.node_page_size;
+            _btree_header->_dirty = true;
+        }
         auto evictor = [](const std::pair<node_id, node>& evicted_item) -> seastar::future<> {
             auto evicted_node = evicted_item.second;
             return evicted_node.flush().finally([evicted_node] {});
         };
-        _cache = std::make_unique<cache<node_id, node>>(_config.n_cached_nodes, std::move(evictor));
-        return get_or_create_page(page_id{static_cast<page_id::underlying_type>(_btree_header->_root.get())}).then([this](auto root) {
-            _btree_header->_page_count++;
+        _cache = make_cache<node_id, node>(_config.node_cache_policy, _config.n_cached_nodes, std::move(evictor));
+        _buffer_manager.add_shrinker([this] {
+            return _cache->shrink();
+        });
+        const auto root_id = page_id{static_cast<page_id::underlying_type>(_btree_header->_root.get())};
+        return get_or_create_page(root_id, _config.node_page_size).then([this](auto root) {
+            _btree_header->_page_count += get_page_span(_config.node_page_size);
             _btree_header->_dirty = true;
             _root = node{root, get_pointer()};
             SPIDERDB_LOGGER_DEBUG("Root {:0>12} - Created", _root.get_id());
@@ -71,24 +89,56 @@ seastar::future<> btree_impl::open() {
 }
 
 seastar::future<> btree_impl::flush() {
-    return seastar::parallel_for_each(_cache->get_all_items(), [](auto item) {
+    return seastar::parallel_for_each(_cache->get_items(), [](auto item) {
         auto node = item.second;
         return node.flush().finally([node] {});
     }).then([this] {
         return _cache->clear();
     }).then([this] {
+        return seastar::parallel_for_each(std::exchange(_pinned_nodes, {}), [](auto item) {
+            auto node = item.second;
+            return node.flush().finally([node] {});
+        });
+    }).then([this] {
+        _buffer_manager.remove_pinned_bytes(std::exchange(_pinned_bytes, 0));
         return file_impl::flush();
     });
 }
 
+seastar::future<> btree_impl::checkpoint() {
+    // Unlike flush, keep the nodes cached. The root is already flushed and gone when closing.
+    auto flushed_root = _root ? _root.flush() : seastar::now();
+    return flushed_root.then([this] {
+        return seastar::parallel_for_each(_cache->get_items(), [](auto item) {
+            auto node = item.second;
+            return node.flush().finally([node] {});
+        });
+    }).then([this] {
+        return seastar::parallel_for_each(_pinned_nodes, [](auto item) {
+            auto node = item.second;
+            return node.flush().finally([node] {});
+        });
+    }).then([this] {
+        return file_impl::checkpoint();
+    });
+}
+
 seastar::future<> btree_impl::close() {
     if (!btree_impl::is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
+    _warming_up = false;
     auto root = std::move(_root);
-    return root.flush().finally([this, root] {
-        return file_impl::close().then([] {
-            SPIDERDB_LOGGER_INFO("Closed B-Tree");
+    return std::exchange(_warm_up, seastar::make_ready_future<>()).then([this] {
+        // Taken before the caches are flushed
+        return save_warm_pages();
+    }).then([this] {
+        return std::exchange(_read_ahead, seastar::make_ready_future<>());
+    }).then([this, root] {
+        return root.flush().finally([this, root] {
+            return file_impl::close().then([] {
+                SPIDERDB_LOGGER_INFO("Closed B-Tree");
+            });
         });
     });
 }
@@ -105,9 +155,9 @@ seastar::future<value_pointer> btree_impl::find(string&& key) {
     return _root.find(std::move(key));
 }
 
-seastar::future<node> btree_impl::create_node(node_type type, seastar::weak_ptr<node_impl>&& parent) {
-    return get_free_page().then([this, type, parent{std::move(parent)}](auto page) mutable {
-        node new_node{page, get_pointer(), std::move(parent)};
+seastar::future<node> btree_impl::create_node(node_type type) {
+    return get_free_page(_config.node_page_size).then([this, type](auto page) {
+        node new_node{page, get_pointer()};
         new_node.get_page().set_type(type);
         _nodes.emplace(new_node.get_id(), new_node.get_pointer());
         return cache_node(new_node).then([this, new_node] {
@@ -117,46 +167,151 @@ seastar::future<node> btree_impl::create_node(node_type type, seastar::weak_ptr<
     });
 }
 
-seastar::future<node> btree_impl::get_node(node_id id, seastar::weak_ptr<node_impl>&& parent) {
-    return seastar::futurize_invoke([this, id] {
+seastar::future<node> btree_impl::get_node(node_id id, bool is_access) {
+    return seastar::futurize_invoke([this, id, is_access] {
+        // If node is pinned
+        auto pinned_node_it = _pinned_nodes.find(id);
+        if (pinned_node_it != _pinned_nodes.end()) {
+            return seastar::make_ready_future<node>(pinned_node_it->second);
+        }
         // If node is still on node cache
+        if (!is_access) {
+            auto cached_node = _cache->peek(id);
+            return cached_node ? seastar::make_ready_future<node>(*cached_node) : load_node(id);
+        }
         return _cache->get(id).then([](auto cached_node) {
             return seastar::make_ready_future<node>(cached_node);
         }).handle_exception([this, id](auto ex) {
-            return seastar::with_semaphore(_get_node_lock, 1, [this, id] {
-                // If node has not been flushed
-                auto node_it = _nodes.find(id);
-                if (node_it != _nodes.end()) {
-                    if (node_it->second) {
-                        return seastar::make_ready_future<node>(node_it->second->shared_from_this());
-                    }
-                    _nodes.erase(node_it);
-                }
-                // Otherwise
-                return get_or_create_page(page_id{static_cast<page_id::underlying_type>(id.get())}).then([this](auto page) {
-                    auto loading_node = node{page, get_pointer()};
-                    return loading_node.load().then([this, loading_node] {
-                        _nodes.emplace(loading_node.get_id(), loading_node.get_pointer());
-                        return seastar::make_ready_future<node>(loading_node);
-                    });
-                });
-            });
+            return load_node(id);
         });
-    }).then([this, parent{std::move(parent)}](auto loaded_node) mutable {
-        loaded_node.update_parent(std::move(parent));
+    }).then([this](auto loaded_node) {
         return cache_node(loaded_node).then([loaded_node] {
             return seastar::make_ready_future<node>(loaded_node);
         });
     });
 }
 
+seastar::future<node> btree_impl::load_node(node_id id) {
+    // If node has not been flushed
+    auto node_it = _nodes.find(id);
+    if (node_it != _nodes.end()) {
+        if (node_it->second) {
+            return seastar::make_ready_future<node>(node_it->second->shared_from_this());
+        }
+        _nodes.erase(node_it);
+    }
+    // If node is being loaded by another request
+    auto loading_node_it = _loading_nodes.find(id);
+    if (loading_node_it != _loading_nodes.end()) {
+        return loading_node_it->second.get_future();
+    }
+    // Otherwise
+    const auto pid = page_id{static_cast<page_id::underlying_type>(id.get())};
+    seastar::shared_future<node> loading_node = get_or_create_page(pid, _config.node_page_size).then([this](auto page) {
+        auto loaded_node = node{page, get_pointer()};
+        return loaded_node.load().then([this, loaded_node] {
+            _nodes.emplace(loaded_node.get_id(), loaded_node.get_pointer());
+            ++_n_loaded_nodes;
+            return seastar::make_ready_future<node>(loaded_node);
+        });
+    }).finally([this, id] {
+        _loading_nodes.erase(id);
+    });
+    if (!loading_node.available()) {
+        _loading_nodes.emplace(id, loading_node);
+    }
+    return loading_node.get_future();
+}
+
 seastar::future<> btree_impl::cache_node(node node) {
+    if (_config.pin_internal_nodes) {
+        auto pinned_node_it = _pinned_nodes.find(node.get_id());
+        if (node.get_page().get_type() == node_type::internal) {
+            if (pinned_node_it != _pinned_nodes.end()) {
+                return seastar::now();
+            }
+            const auto size = node.get_page().get_size();
+            if (_pinned_bytes + size <= _config.max_pinned_node_bytes) {
+                _pinned_nodes.emplace(node.get_id(), node);
+                _pinned_bytes += size;
+                _buffer_manager.add_pinned_bytes(size);
+                return seastar::now();
+            }
+        } else if (pinned_node_it != _pinned_nodes.end()) {
+            // Destroyed, or turned back into a leaf
+            const auto size = pinned_node_it->second.get_page().get_size();
+            _pinned_bytes -= size;
+            _buffer_manager.remove_pinned_bytes(size);
+            _pinned_nodes.erase(pinned_node_it);
+        }
+    }
+    // The access that found a resident node has been counted already
+    if (_cache->peek(node.get_id())) {
+        return seastar::now();
+    }
     return _cache->put(node.get_id(), node);
 }
 
+uint64_t btree_impl::get_pinned_bytes() const noexcept {
+    return _pinned_bytes;
+}
+
+uint64_t btree_impl::get_loaded_node_count() const noexcept {
+    return _n_loaded_nodes;
+}
+
+void btree_impl::on_leaf_access(const node& leaf) {
+    const auto id = leaf.get_id();
+    if (id == _last_leaf) {
+        return;
+    }
+    // Detect a run of accesses along the sibling links
+    const bool forward = id == _last_leaf_next;
+    const bool sequential = forward || id == _last_leaf_prev;
+    if (sequential && forward == _forward) {
+        ++_sequential_run;
+        if (_read_ahead_distance > 0) {
+            --_read_ahead_distance;
+        }
+    } else {
+        _sequential_run = sequential ? 1 : 0;
+        _forward = forward || !sequential;
+        _read_ahead_window = 0;
+        _read_ahead_distance = 0;
+    }
+    _last_leaf = id;
+    _last_leaf_next = leaf.get_next_node();
+    _last_leaf_prev = leaf.get_prev_node();
+    if (_sequential_scans == 0 && _sequential_run < _config.read_ahead_trigger) {
+        return;
+    }
+    if (_reading_ahead || _read_ahead_distance > _read_ahead_window / 2) {
+        return;
+    }
+    // Grow the window while the run lasts
+    _read_ahead_window = std::min(std::max(_read_ahead_window * 2, 1u), _config.max_read_ahead_leaves);
+    if (_read_ahead_distance == 0) {
+        _read_ahead_frontier = id;
+    }
+    read_ahead(_read_ahead_frontier, _read_ahead_window - _read_ahead_distance);
+}
+
+void btree_impl::start_sequential_scan() noexcept {
+    ++_sequential_scans;
+}
+
+void btree_impl::stop_sequential_scan() noexcept {
+    if (_sequential_scans > 0) {
+        --_sequential_scans;
+    }
+}
+
 void btree_impl::log() const noexcept {
     file_impl::log();
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Root: ", _btree_header->_root);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Node page size: ", _btree_header->_node_page_size);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Pinned nodes: ", _pinned_nodes.size());
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Pinned bytes: ", _pinned_bytes);
 }
 
 bool btree_impl::is_open() const noexcept {
@@ -171,10 +326,192 @@ seastar::shared_ptr<page_header> btree_impl::get_new_page_header() {
     return seastar::make_shared<node_header>();
 }
 
+seastar::future<> btree_impl::check_header() {
+    return file_impl::check_header().then([this] {
+        auto header = seastar::dynamic_pointer_cast<btree_header>(_file_header);
+        _config.node_page_size = header->_node_page_size;
+        if (!is_valid_page_size(_config.node_page_size)) {
+            return seastar::make_exception_future<>(std::invalid_argument("Node page size is not a multiple of the page size"));
+        }
+        return seastar::now();
+    });
+}
+
+seastar::future<> btree_impl::read_ahead_values(node leaf) {
+    return seastar::now();
+}
+
+void btree_impl::get_warm_pages(std::vector<std::pair<page_id, page_type>>& pages) const {
+    // Pinned nodes are the hottest ones
+    for (const auto& item : _pinned_nodes) {
+        pages.emplace_back(item.second.get_page().get_id(), item.second.get_page().get_type());
+    }
+    for (const auto& item : _cache->get_items()) {
+        pages.emplace_back(item.second.get_page().get_id(), item.second.get_page().get_type());
+    }
+}
+
+seastar::future<> btree_impl::warm_up_page(page_id id, page_type type) {
+    if (type != page_type::internal && type != page_type::leaf) {
+        return seastar::now();
+    }
+    return get_or_create_page(id, _config.node_page_size).then([this, type](auto page) {
+        // The page may have been reused since the snapshot was taken
+        if (page.get_type() != type) {
+            return seastar::now();
+        }
+        return get_node(node_id{static_cast<node_id::underlying_type>(page.get_id().get())}).discard_result().finally([page] {});
+    });
+}
+
+void btree_impl::start_warm_up() {
+    _warming_up = true;
+    _warm_up = load_warm_pages().then([this](auto pages) {
+        // Loaded in file order, so the reads sweep the file once
+        std::sort(pages.begin(), pages.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first.get() < rhs.first.get();
+        });
+        pages.erase(std::unique(pages.begin(), pages.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first.get() == rhs.first.get();
+        }), pages.end());
+        return seastar::do_with(std::move(pages), [this](auto& pages) {
+            return seastar::parallel_for_each(pages, [this](auto item) {
+                return seastar::with_semaphore(_warm_up_limit, 1, [this, item] {
+                    if (!_warming_up || !is_open()) {
+                        return seastar::now();
+                    }
+                    return warm_up_page(item.first, item.second).handle_exception([item](auto ex) {
+                        SPIDERDB_LOGGER_DEBUG("Page {:0>12} - Skipped warm-up: {}", item.first, ex);
+                    });
+                });
+            }).then([&pages] {
+                if (!pages.empty()) {
+                    SPIDERDB_LOGGER_INFO("Warmed up {} pages", pages.size());
+                }
+            });
+        });
+    }).handle_exception([](auto ex) {
+        SPIDERDB_LOGGER_WARN("Failed to warm up: {}", ex);
+    }).finally([this] {
+        _warming_up = false;
+    });
+}
+
+std::string btree_impl::get_warm_up_file_name() const {
+    return fmt::format("{}.warm", get_name());
+}
+
+seastar::future<> btree_impl::save_warm_pages() {
+    if (!_config.warm_up_on_open) {
+        return seastar::now();
+    }
+    std::vector<std::pair<page_id, page_type>> pages;
+    get_warm_pages(pages);
+    const auto flags = seastar::open_flags::create | seastar::open_flags::truncate | seastar::open_flags::wo;
+    return seastar::open_file_dma(get_warm_up_file_name(), flags).then([pages{std::move(pages)}](auto file) mutable {
+        const uint64_t count = pages.size();
+        const uint64_t len = sizeof(count) + count * (sizeof(page_id) + sizeof(page_type));
+        const uint64_t alignment = file.disk_write_dma_alignment();
+        const uint64_t aligned_len = (len + alignment - 1) / alignment * alignment;
+        auto buffer = seastar::temporary_buffer<char>::aligned(file.memory_dma_alignment(), aligned_len);
+        memset(buffer.get_write(), 0, aligned_len);
+        auto pos = buffer.get_write();
+        memcpy(pos, &count, sizeof(count));
+        pos += sizeof(count);
+        for (const auto& item : pages) {
+            memcpy(pos, &item.first, sizeof(item.first));
+            pos += sizeof(item.first);
+            memcpy(pos, &item.second, sizeof(item.second));
+            pos += sizeof(item.second);
+        }
+        auto data = buffer.get();
+        return file.dma_write(0, data, aligned_len).then([file](auto) mutable {
+            return file.flush();
+        }).finally([file, buffer{std::move(buffer)}]() mutable {
+            return file.close().finally([file] {});
+        });
+    }).handle_exception([](auto ex) {
+        // Only costs a cold start
+        SPIDERDB_LOGGER_WARN("Failed to save the warm-up pages: {}", ex);
+    });
+}
+
+seastar::future<std::vector<std::pair<page_id, page_type>>> btree_impl::load_warm_pages() {
+    using warm_pages = std::vector<std::pair<page_id, page_type>>;
+    auto name = get_warm_up_file_name();
+    return seastar::file_exists(name).then([this, name](auto exists) {
+        if (!exists) {
+            return seastar::make_ready_future<warm_pages>();
+        }
+        return seastar::open_file_dma(name, seastar::open_flags::ro).then([](auto file) {
+            return file.size().then([file](auto size) mutable {
+                return file.dma_read_bulk<char>(0, size);
+            }).finally([file]() mutable {
+                return file.close().finally([file] {});
+            });
+        }).then([this](auto buffer) {
+            warm_pages pages;
+            if (!_config.warm_up_on_open || buffer.size() < sizeof(uint64_t)) {
+                return pages;
+            }
+            uint64_t count;
+            memcpy(&count, buffer.begin(), sizeof(count));
+            buffer.trim_front(sizeof(count));
+            count = std::min<uint64_t>(count, buffer.size() / (sizeof(page_id) + sizeof(page_type)));
+            pages.reserve(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                page_id::underlying_type id;
+                memcpy(&id, buffer.begin(), sizeof(id));
+                buffer.trim_front(sizeof(id));
+                page_type type;
+                memcpy(&type, buffer.begin(), sizeof(type));
+                buffer.trim_front(sizeof(type));
+                pages.emplace_back(page_id{id}, type);
+            }
+            return pages;
+        }).finally([name] {
+            // A snapshot outlived by a crash would be stale, so it is used only once
+            return seastar::remove_file(name);
+        });
+    });
+}
+
 seastar::weak_ptr<btree_impl> btree_impl::get_pointer() noexcept {
     return seastar::weakly_referencable<btree_impl>::weak_from_this();
 }
 
+void btree_impl::read_ahead(node_id from, uint32_t n_leaves) {
+    if (n_leaves == 0) {
+        return;
+    }
+    _reading_ahead = true;
+    _read_ahead = seastar::do_with(from, n_leaves, _forward, [this](auto& id, auto& n_leaves, auto forward) {
+        return seastar::do_until([this, &n_leaves] {
+            return n_leaves == 0 || !is_open();
+        }, [this, &id, &n_leaves, forward] {
+            // Reading ahead is not an access, so the leaves only count as accessed once the scan reaches them
+            return get_node(id, false).then([this, &id, &n_leaves, forward](auto current) {
+                auto next = forward ? current.get_next_node() : current.get_prev_node();
+                if (next == null_node) {
+                    n_leaves = 0;
+                    return seastar::now();
+                }
+                return get_node(next, false).then([this, &id, &n_leaves](auto leaf) {
+                    id = leaf.get_id();
+                    --n_leaves;
+                    ++_read_ahead_distance;
+                    _read_ahead_frontier = id;
+                    return read_ahead_values(leaf);
+                });
+            });
+        });
+    }).handle_exception([](auto ex) {
+        SPIDERDB_LOGGER_DEBUG("Read-ahead stopped: {}", ex);
+    }).finally([this] {
+        _reading_ahead = false;
+    });
+}
+
 btree::btree(std::string name, spiderdb_config config) {
     _impl = seastar::make_lw_shared<btree_impl>(std::move(name), config);
 }
@@ -208,7 +545,9 @@ seastar::future<> btree::open() const {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
-    return _impl->open();
+    return _impl->open().then([impl{_impl}] {
+        impl->start_warm_up();
+    });
 }
 
 seastar::future<> btree::close() const {
@@ -251,6 +590,27 @@ seastar::future<value_pointer> btree::find(string&& key) const {
     return _impl->find(std::move(key));
 }
 
+void btree::start_sequential_scan() const {
+    if (!_impl || !_impl->is_open()) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    _impl->start_sequential_scan();
+}
+
+void btree::stop_sequential_scan() const {
+    if (!_impl || !_impl->is_open()) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    _impl->stop_sequential_scan();
+}
+
+uint64_t btree::get_loaded_node_count() const {
+    if (!_impl || !_impl->is_open()) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    return _impl->get_loaded_node_count();
+}
+
 void btree::log() const {
     if (!_impl || !_impl->is_open()) {
         throw spiderdb_error{error_code::closed_error};
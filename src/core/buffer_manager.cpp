@@ -0,0 +1,161 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#include <spiderdb/core/buffer_manager.h>
+#include <spiderdb/util/log.h>
+#include <seastar/core/future-util.hh>
+#include <algorithm>
+
+namespace spiderdb {
+
+buffer_manager::buffer_manager(const spiderdb_config& config, page_frame_arena& arena)
+        : _config{config}, _arena{arena}, _budget{config.buffer_budget} {}
+
+void buffer_manager::start() {
+    _stopped = false;
+    _shrink_stalled = false;
+    _budget = std::clamp(_config.buffer_budget, _config.min_buffer_budget, _config.max_buffer_budget);
+    _reclaimer = std::make_unique<seastar::memory::reclaimer>([this](auto request) {
+        return reclaim(request);
+    });
+    _shrinking = seastar::do_until([this] {
+        return _stopped;
+    }, [this] {
+        return _shrink_cond.wait(_config.buffer_budget_interval, [this] {
+            return _stopped || (is_over_budget() && !_shrink_stalled);
+        }).then_wrapped([this](auto f) {
+            if (f.failed()) {
+                // Triggered by the budget interval
+                f.ignore_ready_future();
+                adjust_budget();
+            }
+            return shrink();
+        });
+    }).handle_exception([](auto ex) {
+        SPIDERDB_LOGGER_ERROR("Buffer manager stopped: {}", ex);
+    });
+}
+
+seastar::future<> buffer_manager::stop() {
+    _stopped = true;
+    _reclaimer.reset();
+    _shrink_cond.broadcast();
+    return std::exchange(_shrinking, seastar::make_ready_future<>()).then([this] {
+        _shrinkers.clear();
+        _next_shrinker = 0;
+    });
+}
+
+void buffer_manager::add_shrinker(shrinker shrinker) {
+    _shrinkers.push_back(std::move(shrinker));
+}
+
+void buffer_manager::add_dirty_bytes(uint64_t bytes) noexcept {
+    _dirty_bytes += bytes;
+}
+
+void buffer_manager::remove_dirty_bytes(uint64_t bytes) noexcept {
+    _dirty_bytes -= std::min(bytes, _dirty_bytes);
+    // Written back pages can be evicted
+    resume_shrinking();
+}
+
+void buffer_manager::add_pinned_bytes(uint64_t bytes) noexcept {
+    _pinned_bytes += bytes;
+}
+
+void buffer_manager::remove_pinned_bytes(uint64_t bytes) noexcept {
+    _pinned_bytes -= std::min(bytes, _pinned_bytes);
+    resume_shrinking();
+}
+
+void buffer_manager::check_budget() noexcept {
+    if (is_over_budget()) {
+        _shrink_cond.signal();
+    }
+}
+
+uint64_t buffer_manager::get_budget() const noexcept {
+    return _budget;
+}
+
+uint64_t buffer_manager::get_resident_bytes() const noexcept {
+    return _arena.get_resident_bytes();
+}
+
+uint64_t buffer_manager::get_dirty_bytes() const noexcept {
+    return _dirty_bytes;
+}
+
+bool buffer_manager::is_over_budget() const noexcept {
+    return get_resident_bytes() > _budget;
+}
+
+void buffer_manager::log() const noexcept {
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Buffer budget: ", _budget);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Resident bytes: ", get_resident_bytes());
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Dirty bytes: ", _dirty_bytes);
+}
+
+seastar::memory::reclaiming_result buffer_manager::reclaim(seastar::memory::reclaimer::request request) {
+    // Evicting items takes I/O, so only the free frames are released here and the rest is left to the shrinking fiber
+    const auto released_bytes = _arena.trim();
+    const auto cut = std::max<uint64_t>(request.bytes_to_reclaim, _budget / 8);
+    _budget = std::max(_budget - std::min(cut, _budget), get_min_budget());
+    _shrink_cond.signal();
+    if (released_bytes == 0) {
+        return seastar::memory::reclaiming_result::reclaimed_nothing;
+    }
+    return seastar::memory::reclaiming_result::reclaimed_something;
+}
+
+void buffer_manager::adjust_budget() noexcept {
+    // Grow into a share of the free memory of the shard, or give back what is no longer free
+    const auto free_memory = seastar::memory::stats().free_memory();
+    const auto headroom = static_cast<uint64_t>(free_memory * _config.max_free_memory_ratio);
+    const auto limit = std::max(std::min(get_resident_bytes() + headroom, _config.max_buffer_budget), get_min_budget());
+    if (_budget < limit) {
+        _budget = std::min(limit, _budget + _budget / 8);
+    } else {
+        _budget = limit;
+    }
+}
+
+seastar::future<> buffer_manager::shrink() {
+    if (!is_over_budget()) {
+        return seastar::now();
+    }
+    _arena.trim();
+    _shrink_stalled = false;
+    return seastar::do_with(size_t{0}, [this](auto& n_idle_shrinkers) {
+        return seastar::do_until([this, &n_idle_shrinkers] {
+            return _stopped || !is_over_budget() || n_idle_shrinkers >= _shrinkers.size();
+        }, [this, &n_idle_shrinkers] {
+            // Take one item from each cache in turn so that none of them is drained alone
+            auto& shrinker = _shrinkers[_next_shrinker++ % _shrinkers.size()];
+            return shrinker().then([this, &n_idle_shrinkers](auto evicted) {
+                n_idle_shrinkers = evicted ? 0 : n_idle_shrinkers + 1;
+                // Frames of evicted items return to the arena first
+                _arena.trim();
+            });
+        }).then([this] {
+            // Every cache is drained down to dirty or pinned items, so retrying right away would only spin
+            _shrink_stalled = !_stopped && is_over_budget();
+        });
+    });
+}
+
+uint64_t buffer_manager::get_min_budget() const noexcept {
+    // Pinned nodes are never evicted, so the budget always leaves room for them
+    return _config.min_buffer_budget + _pinned_bytes;
+}
+
+void buffer_manager::resume_shrinking() noexcept {
+    if (_shrink_stalled) {
+        _shrink_stalled = false;
+        check_budget();
+    }
+}
+
+}
@@ -6,9 +6,135 @@
 #include <spiderdb/util/log.h>
 #include <spiderdb/util/error.h>
 #include <seastar/core/seastar.hh>
+#include <seastar/core/with_scheduling_group.hh>
+#include <seastar/core/sleep.hh>
 
 namespace spiderdb {
 
+namespace {
+
+uint32_t get_checksum(const char* data, size_t len) {
+    // FNV-1a
+    uint32_t res = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        res ^= static_cast<unsigned char>(data[i]);
+        res *= 16777619u;
+    }
+    return res;
+}
+
+}
+
+void free_space_map::release(page_id first, uint64_t count) {
+    if (first == null_page || count == 0) {
+        return;
+    }
+    auto start = first.get();
+    auto end = start + static_cast<page_id::underlying_type>(count);
+    _free_page_count += count;
+    _dirty = true;
+    // Coalesce with the following extent
+    auto next_it = _extents.lower_bound(start);
+    if (next_it != _extents.end() && next_it->first == end) {
+        end += static_cast<page_id::underlying_type>(next_it->second);
+        next_it = _extents.erase(next_it);
+    }
+    // Coalesce with the preceding extent
+    if (next_it != _extents.begin()) {
+        auto prev_it = std::prev(next_it);
+        if (prev_it->first + static_cast<page_id::underlying_type>(prev_it->second) == start) {
+            prev_it->second = end - prev_it->first;
+            return;
+        }
+    }
+    _extents.emplace_hint(next_it, start, end - start);
+}
+
+page_id free_space_map::allocate(uint64_t count) {
+    auto it = std::find_if(_extents.begin(), _extents.end(), [count](const auto& extent) {
+        return extent.second >= count;
+    });
+    if (it == _extents.end()) {
+        return null_page;
+    }
+    auto first = it->first;
+    auto remaining = it->second - count;
+    it = _extents.erase(it);
+    if (remaining > 0) {
+        _extents.emplace_hint(it, first + static_cast<page_id::underlying_type>(count), remaining);
+    }
+    _free_page_count -= count;
+    _dirty = true;
+    return page_id{first};
+}
+
+seastar::future<> free_space_map::write(seastar::temporary_buffer<char> buffer) {
+    _extents.clear();
+    _free_page_count = 0;
+    uint64_t size;
+    if (buffer.size() < sizeof(size)) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    memcpy(&size, buffer.begin(), sizeof(size));
+    buffer.trim_front(sizeof(size));
+    // A count that does not fit the pages read back means the map is corrupted
+    if (size > buffer.size() / (sizeof(page_id::underlying_type) + sizeof(uint64_t))) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    for (uint64_t i = 0; i < size; ++i) {
+        page_id::underlying_type first;
+        memcpy(&first, buffer.begin(), sizeof(first));
+        buffer.trim_front(sizeof(first));
+        uint64_t count;
+        memcpy(&count, buffer.begin(), sizeof(count));
+        buffer.trim_front(sizeof(count));
+        _extents.emplace_hint(_extents.end(), first, count);
+        _free_page_count += count;
+    }
+    _dirty = false;
+    return seastar::now();
+}
+
+seastar::future<> free_space_map::read(seastar::temporary_buffer<char> buffer) {
+    uint64_t size = _extents.size();
+    memcpy(buffer.get_write(), &size, sizeof(size));
+    buffer.trim_front(sizeof(size));
+    for (const auto& extent : _extents) {
+        memcpy(buffer.get_write(), &extent.first, sizeof(extent.first));
+        buffer.trim_front(sizeof(extent.first));
+        memcpy(buffer.get_write(), &extent.second, sizeof(extent.second));
+        buffer.trim_front(sizeof(extent.second));
+    }
+    return seastar::now();
+}
+
+size_t free_space_map::size() const noexcept {
+    return sizeof(uint64_t) + _extents.size() * (sizeof(page_id::underlying_type) + sizeof(uint64_t));
+}
+
+uint64_t free_space_map::get_free_page_count() const noexcept {
+    return _free_page_count;
+}
+
+page_id free_space_map::get_free_tail(uint64_t page_count) const noexcept {
+    if (_extents.empty()) {
+        return null_page;
+    }
+    const auto& last = *_extents.rbegin();
+    if (last.first + last.second != page_count) {
+        return null_page;
+    }
+    return page_id{last.first};
+}
+
+bool free_space_map::is_dirty() const noexcept {
+    return _dirty;
+}
+
+void free_space_map::mark_clean() noexcept {
+    _dirty = false;
+}
+
 seastar::future<> file_header::flush(seastar::file file) {
     if (!file) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
@@ -16,7 +142,7 @@ seastar::future<> file_header::flush(seastar::file file) {
     if (!_dirty) {
         return seastar::now();
     }
-    seastar::temporary_buffer<char> buffer{_size};
+    auto buffer = seastar::temporary_buffer<char>::aligned(file.memory_dma_alignment(), _size);
     return seastar::do_with(std::move(buffer), [this, file](auto& buffer) mutable {
         return read(buffer.share()).then([this, file, buffer{buffer.share()}]() mutable {
             return file.dma_write(0, buffer.begin(), buffer.size()).then([this](auto) {
@@ -36,31 +162,36 @@ seastar::future<> file_header::load(seastar::file file) {
 }
 
 seastar::future<> file_header::write(seastar::temporary_buffer<char> buffer) {
+    memcpy(&_format_version, buffer.begin(), sizeof(_format_version));
+    buffer.trim_front(sizeof(_format_version));
     memcpy(&_page_size, buffer.begin(), sizeof(_page_size));
     buffer.trim_front(sizeof(_page_size));
     memcpy(&_page_count, buffer.begin(), sizeof(_page_count));
     buffer.trim_front(sizeof(_page_count));
-    memcpy(&_first_free_page, buffer.begin(), sizeof(_first_free_page));
-    buffer.trim_front(sizeof(_first_free_page));
-    memcpy(&_last_free_page, buffer.begin(), sizeof(_last_free_page));
-    buffer.trim_front(sizeof(_last_free_page));
+    memcpy(&_free_space_page, buffer.begin(), sizeof(_free_space_page));
+    buffer.trim_front(sizeof(_free_space_page));
+    memcpy(&_free_space_page_count, buffer.begin(), sizeof(_free_space_page_count));
+    buffer.trim_front(sizeof(_free_space_page_count));
     return seastar::now();
 }
 
 seastar::future<> file_header::read(seastar::temporary_buffer<char> buffer) {
     memset(buffer.get_write(), 0, _size);
+    memcpy(buffer.get_write(), &_format_version, sizeof(_format_version));
+    buffer.trim_front(sizeof(_format_version));
     memcpy(buffer.get_write(), &_page_size, sizeof(_page_size));
     buffer.trim_front(sizeof(_page_size));
     memcpy(buffer.get_write(), &_page_count, sizeof(_page_count));
     buffer.trim_front(sizeof(_page_count));
-    memcpy(buffer.get_write(), &_first_free_page, sizeof(_first_free_page));
-    buffer.trim_front(sizeof(_first_free_page));
-    memcpy(buffer.get_write(), &_last_free_page, sizeof(_last_free_page));
-    buffer.trim_front(sizeof(_last_free_page));
+    memcpy(buffer.get_write(), &_free_space_page, sizeof(_free_space_page));
+    buffer.trim_front(sizeof(_free_space_page));
+    memcpy(buffer.get_write(), &_free_space_page_count, sizeof(_free_space_page_count));
+    buffer.trim_front(sizeof(_free_space_page_count));
     return seastar::now();
 }
 
-file_impl::file_impl(std::string name, spiderdb_config config) : _name{std::move(name)}, _config{std::move(config)} {
+file_impl::file_impl(std::string name, spiderdb_config config)
+        : _name{std::move(name)}, _config{std::move(config)}, _page_frame_arena{_config} {
     spiderdb_logger.set_level(_config.log_level);
 }
 
@@ -77,30 +208,73 @@ seastar::future<> file_impl::open() {
     }
     _file_header = get_new_file_header();
     _file_header->_size = _config.file_header_size;
+    _file_header->_format_version = file_header::format_version();
     _file_header->_page_size = _config.page_size;
     return seastar::file_exists(_name).then([this](auto exists) {
         return seastar::open_file_dma(_name, seastar::open_flags::create | seastar::open_flags::rw).then([this, exists](auto file) {
             _file = file;
+            _created = !exists;
             if (exists) {
                 SPIDERDB_LOGGER_INFO("Opened file: {}", _name);
-                return _file_header->load(file);
+                return recover_double_write_buffer().then([this, file] {
+                    return _file_header->load(file);
+                }).then([this] {
+                    // Pages written in another layout cannot be read back
+                    if (_file_header->_format_version != file_header::format_version()) {
+                        return seastar::make_exception_future<>(spiderdb_error{error_code::file_format_mismatch, fmt::format(
+                                "created with format {}, opened with {}", _file_header->_format_version, file_header::format_version()
+                        )});
+                    }
+                    // Page ids are only meaningful in the unit the file was created with
+                    _config.page_size = _file_header->_page_size;
+                    return check_header();
+                }).then([this] {
+                    return load_free_space_map();
+                });
             } else {
                 SPIDERDB_LOGGER_INFO("Created file: {}", _name);
-                return _file_header->flush(file);
+                _free_space_map = free_space_map{};
+                // Left by a file that no longer exists
+                return remove_double_write_buffer().then([this, file] {
+                    return _file_header->flush(file);
+                });
             }
         });
+    }).then([this] {
+        // Only started on a usable file, as they run against it until it is closed
+        start_writeback();
+        _buffer_manager.start();
+    }).handle_exception([this](auto ex) {
+        // Leave the file closed, so that it can be opened again
+        auto file = std::move(_file);
+        auto closed = file ? file.close() : seastar::now();
+        return closed.handle_exception([](auto close_ex) {
+            SPIDERDB_LOGGER_ERROR("Failed to close file: {}", close_ex);
+        }).then([this, ex, file] {
+            _file_lock.signal();
+            return seastar::make_exception_future<>(ex);
+        });
     });
 }
 
 seastar::future<> file_impl::flush() {
-    return _file_header->flush(_file).then([this] {
+    return checkpoint().then([this] {
+        return _file.flush();
+    }).then([this] {
         SPIDERDB_LOGGER_INFO("Flushed file: {}", _name);
         log();
     });
 }
 
 seastar::future<> file_impl::close() {
-    return flush().then([this] {
+    // Wait for pending commits
+    return seastar::with_semaphore(_commit_lock, 1, [] {}).then([this] {
+        return flush();
+    }).then([this] {
+        return stop_writeback();
+    }).then([this] {
+        return _buffer_manager.stop();
+    }).then([this] {
         if (!file_impl::is_open()) {
             return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
         }
@@ -112,8 +286,38 @@ seastar::future<> file_impl::close() {
     });
 }
 
+seastar::future<> file_impl::commit(durability level) {
+    if (level == durability::in_memory) {
+        return seastar::now();
+    }
+    if (!_commit_batch) {
+        _commit_batch = seastar::make_lw_shared<commit_batch>();
+        auto batch = _commit_batch;
+        // Writers arriving while the previous batch is in progress or within the window share this batch
+        (void)seastar::with_semaphore(_commit_lock, 1, [this, batch] {
+            return seastar::sleep(_config.group_commit_window).then([this, batch] {
+                _commit_batch = nullptr;
+                return checkpoint();
+            }).then([this, batch] {
+                if (batch->_level != durability::synced) {
+                    return seastar::now();
+                }
+                return _file.flush();
+            });
+        }).then_wrapped([batch](auto f) {
+            if (f.failed()) {
+                batch->_done.set_exception(f.get_exception());
+            } else {
+                batch->_done.set_value();
+            }
+        });
+    }
+    _commit_batch->_level = std::max(_commit_batch->_level, level);
+    return _commit_batch->_done.get_shared_future();
+}
+
 seastar::future<page_id> file_impl::write(string data) {
-    return get_free_page().then([this, data{std::move(data)}](auto free_page) mutable {
+    return get_free_page(_config.page_size).then([this, data{std::move(data)}](auto free_page) mutable {
         return write(free_page, std::move(data)).then([free_page] {
             return seastar::make_ready_future<page_id>(free_page.get_id());
         });
@@ -121,124 +325,142 @@ seastar::future<page_id> file_impl::write(string data) {
 }
 
 seastar::future<> file_impl::write(page_id id, string data) {
-    return get_or_create_page(id).then([this, data{std::move(data)}](auto page) mutable {
+    return get_or_create_page(id, _config.page_size).then([this, data{std::move(data)}](auto page) mutable {
         return write(page, std::move(data));
     });
 }
 
 seastar::future<string> file_impl::read(page_id id) {
-    return get_or_create_page(id).then([this](auto page) mutable {
+    return get_or_create_page(id, _config.page_size).then([this](auto page) mutable {
         return read(page);
     });
 }
 
 seastar::future<> file_impl::unlink_pages_from(page_id id) {
-    return get_or_create_page(id).then([this](auto page) {
+    return get_or_create_page(id, _config.page_size).then([this](auto page) {
         return unlink_pages_from(page);
     });
 }
 
 seastar::future<> file_impl::write(page first, string data) {
-    return seastar::do_with(data.get_input_stream(), [this, first](auto& is) mutable {
-        first.set_record_length(is.size());
-        auto current_page_ptr = seastar::make_lw_shared<page>(first);
-        return first.write(is).then([this, &is, current_page_ptr] {
-            return seastar::repeat([this, &is, current_page_ptr]() mutable {
-                auto next_page = current_page_ptr->get_next_page();
-                if (is.size() == 0) {
-                    current_page_ptr->set_next_page(null_page);
-                    return current_page_ptr->flush(_file).then([this, next_page] {
-                        if (next_page == null_page) {
-                            return seastar::now();
-                        }
-                        return unlink_pages_from(next_page);
-                    }).then([] {
-                        return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
-                    });
-                }
-                return seastar::futurize_invoke([this, next_page]() mutable {
-                    if (next_page == null_page) {
-                        return get_free_page();
-                    }
-                    return get_or_create_page(next_page);
-                }).then([this, &is, current_page_ptr](auto next_page) mutable {
-                    current_page_ptr->set_next_page(next_page.get_id());
-                    return current_page_ptr->flush(_file).then([&is, current_page_ptr, next_page]() mutable {
-                        next_page.set_type(page_type::overflow);
-                        return next_page.write(is).then([current_page_ptr, next_page] {
-                            *current_page_ptr = next_page;
-                        });
-                    });
-                }).then([] {
-                    return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::no);
-                });
-            });
-        });
+    // Overflow pages of a record always form one contiguous run of pages as large as the first one, so they are
+    // reused or freed without being read
+    auto next = first.get_next_page();
+    const auto span = get_page_span(first.get_size());
+    const auto old_overflow_page_count = (next != null_page) ? get_overflow_page_count(first.get_record_length(), first.get_size()) : 0;
+    const auto new_overflow_page_count = get_overflow_page_count(data.length(), first.get_size());
+    if (old_overflow_page_count != new_overflow_page_count) {
+        release_pages(next, old_overflow_page_count * span);
+        next = (new_overflow_page_count > 0) ? allocate_pages(new_overflow_page_count * span) : null_page;
+    }
+    return write_pages(first, next, std::move(data));
+}
+
+seastar::future<> file_impl::write(page first, uint32_t len, std::function<void(char*)> encode) {
+    if (len > first.get_work_size() || first.get_next_page() != null_page) {
+        // Spread over overflow pages, or releases the ones left by a longer record
+        string data{len, 0};
+        encode(data.str());
+        return write(first, std::move(data));
+    }
+    first.set_record_length(len);
+    return first.write(len, std::move(encode)).then([this, first]() mutable {
+        first.set_lsn(_lsn);
+        return mark_page_dirty(first);
     });
 }
 
 seastar::future<string> file_impl::read(page first) {
-    seastar::temporary_buffer<char> buffer{first.get_record_length()};
-    seastar::simple_memory_output_stream os{buffer.get_write(), buffer.size()};
-    return seastar::do_with(os, [this, first](auto& os) mutable {
-        auto current_page_ptr = seastar::make_lw_shared<page>(first);
-        return seastar::repeat([this, &os, current_page_ptr]() mutable {
-            return current_page_ptr->read(os).then([this, current_page_ptr]() mutable {
-                if (current_page_ptr->get_next_page() == null_page) {
-                    return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
-                }
-                return get_or_create_page(current_page_ptr->get_next_page()).then([current_page_ptr](auto next_page) mutable {
-                    *current_page_ptr = next_page;
-                    return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::no);
-                });
+    // Overflow pages are contiguous, so they are loaded in parallel
+    std::vector<seastar::future<page>> loading_pages;
+    loading_pages.push_back(seastar::make_ready_future<page>(first));
+    if (first.get_next_page() != null_page) {
+        const auto span = get_page_span(first.get_size());
+        const auto overflow_page_count = get_overflow_page_count(first.get_record_length(), first.get_size());
+        for (uint64_t i = 0; i < overflow_page_count; ++i) {
+            const auto id = first.get_next_page() + page_id{static_cast<page_id::underlying_type>(i * span)};
+            loading_pages.push_back(get_or_create_page(id, first.get_size()));
+        }
+    }
+    return seastar::when_all_succeed(loading_pages.begin(), loading_pages.end()).then([first](auto pages) {
+        seastar::temporary_buffer<char> buffer{first.get_record_length()};
+        seastar::simple_memory_output_stream os{buffer.get_write(), buffer.size()};
+        return seastar::do_with(std::move(pages), os, [](auto& pages, auto& os) {
+            return seastar::do_for_each(pages, [&os](auto& page) {
+                return page.read(os);
             });
+        }).then([buffer{buffer.share()}]() mutable {
+            return seastar::make_ready_future<string>(buffer.begin(), buffer.size());
         });
-    }).then([buffer{buffer.share()}]() mutable {
-        return seastar::make_ready_future<string>(buffer.begin(), buffer.size());
     });
 }
 
 seastar::future<> file_impl::unlink_pages_from(page first) {
-    if (_file_header->_first_free_page == null_page) {
-        _file_header->_first_free_page = first.get_id();
-        _file_header->_dirty = true;
+    // Overflow pages are contiguous, so the whole record is freed without being read
+    const auto span = get_page_span(first.get_size());
+    if (first.get_next_page() != null_page) {
+        release_pages(first.get_next_page(), get_overflow_page_count(first.get_record_length(), first.get_size()) * span);
     }
-    return seastar::futurize_invoke([this, first] {
-        if (_file_header->_last_free_page == null_page) {
-            return seastar::now();
-        }
-        return get_or_create_page(_file_header->_last_free_page).then([this, first](auto last_free_page) {
-            last_free_page.set_next_page(first.get_id());
-            return last_free_page.flush(_file).finally([last_free_page] {});
-        });
-    }).then([this, first] {
-        auto current_page_ptr = seastar::make_lw_shared<page>(first);
-        return seastar::repeat([this, current_page_ptr]() mutable {
-            if (current_page_ptr->get_next_page() == null_page) {
-                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
-            }
-            return get_or_create_page(current_page_ptr->get_next_page()).then([current_page_ptr](auto next_page) mutable {
-                *current_page_ptr = next_page;
-                return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::no);
+    release_pages(first.get_id(), span);
+    first.set_next_page(null_page);
+    first.set_record_length(0);
+    return seastar::now();
+}
+
+seastar::future<> file_impl::write_pages(page first, page_id next, string data) {
+    const auto span = get_page_span(first.get_size());
+    const auto overflow_page_count = get_overflow_page_count(data.length(), first.get_size());
+    std::vector<page> pages{first};
+    pages.reserve(overflow_page_count + 1);
+    for (uint64_t i = 0; i < overflow_page_count; ++i) {
+        auto overflow_page = create_page(next + page_id{static_cast<page_id::underlying_type>(i * span)}, first.get_size());
+        overflow_page.set_type(page_type::overflow);
+        overflow_page.set_record_length(0);
+        pages.back().set_next_page(overflow_page.get_id());
+        pages.push_back(overflow_page);
+    }
+    pages.back().set_next_page(null_page);
+    first.set_record_length(data.length());
+    return seastar::do_with(std::move(data), std::move(pages), [this](auto& data, auto& pages) {
+        return seastar::do_with(data.get_input_stream(), [this, &pages](auto& is) {
+            return seastar::do_for_each(pages, [&is](auto& page) {
+                return page.write(is);
+            });
+        }).then([this, &pages] {
+            // Pages are written to disk by the writeback fiber
+            return seastar::do_for_each(pages, [this](auto& page) {
+                page.set_lsn(_lsn);
+                return mark_page_dirty(page);
             });
-        }).then([this, current_page_ptr] {
-            _file_header->_last_free_page = current_page_ptr->get_id();
-            _file_header->_dirty = true;
         });
     });
 }
 
 void file_impl::log() const noexcept {
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Format version: ", _file_header->_format_version);
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Page size: ", _file_header->_page_size);
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Page count: ", _file_header->_page_count);
-    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "First free page: ", _file_header->_first_free_page);
-    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Last free page: ", _file_header->_last_free_page);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Free space page: ", _file_header->_free_space_page);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Free page count: ", _free_space_map.get_free_page_count());
+    _buffer_manager.log();
 }
 
 bool file_impl::is_open() const noexcept {
     return (bool)_file;
 }
 
+const std::string& file_impl::get_name() const noexcept {
+    return _name;
+}
+
+uint64_t file_impl::get_resident_bytes() const noexcept {
+    return _buffer_manager.get_resident_bytes();
+}
+
+uint64_t file_impl::get_dirty_bytes() const noexcept {
+    return _buffer_manager.get_dirty_bytes();
+}
+
 seastar::shared_ptr<file_header> file_impl::get_new_file_header() {
     return seastar::make_shared<file_header>();
 }
@@ -247,41 +469,522 @@ seastar::shared_ptr<page_header> file_impl::get_new_page_header() {
     return seastar::make_shared<page_header>();
 }
 
-seastar::future<page> file_impl::get_free_page() {
-    return seastar::with_semaphore(_get_free_page_lock, 1, [this] {
-        if (_file_header->_first_free_page != null_page) {
-            return get_or_create_page(_file_header->_first_free_page);
-        } else {
-            return get_or_create_page(page_id{static_cast<page_id::underlying_type>(_file_header->_page_count++)});
+seastar::future<> file_impl::check_header() {
+    // Lets derived files check the fields they add to a loaded header before the file is used
+    return seastar::now();
+}
+
+seastar::future<> file_impl::checkpoint() {
+    return flush_free_space_map().then([this] {
+        if (!_no_steal) {
+            return seastar::now();
         }
-    }).then([this](auto free_page) {
-        _file_header->_first_free_page = free_page.get_next_page();
-        if (_file_header->_first_free_page == null_page) {
-            _file_header->_last_free_page = null_page;
+        // A crash while the pages are written in place must not leave a torn checkpoint behind
+        return write_double_write_buffer();
+    }).then([this] {
+        return write_back(0);
+    }).then([this] {
+        if (_no_steal && !_dirty_pages.empty()) {
+            // Kept in the double-write buffer, which is applied again on open
+            return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+        }
+        return punch_free_tail();
+    }).then([this] {
+        // Pages must be durable before the header that refers to them
+        return _file.flush();
+    }).then([this] {
+        return _file_header->flush(_file);
+    }).then([this] {
+        if (!_no_steal) {
+            return seastar::now();
         }
-        _file_header->_dirty = true;
-        free_page.set_next_page(null_page);
-        free_page.set_type(page_type::unused);
-        return seastar::make_ready_future<page>(free_page);
+        return _file.flush().then([this] {
+            return remove_double_write_buffer();
+        });
     });
 }
 
-seastar::future<page> file_impl::get_or_create_page(page_id id) {
+seastar::future<> file_impl::sync_log(uint64_t lsn) {
+    return seastar::now();
+}
+
+seastar::future<page> file_impl::get_free_page(uint32_t page_size) {
+    auto free_page = create_page(allocate_pages(get_page_span(page_size)), page_size);
+    free_page.set_next_page(null_page);
+    free_page.set_record_length(0);
+    free_page.set_type(page_type::unused);
+    return seastar::make_ready_future<page>(free_page);
+}
+
+seastar::future<page> file_impl::get_or_create_page(page_id id, uint32_t page_size) {
     if (id.get() < 0 || id.get() > _file_header->_page_count) {
         return seastar::make_exception_future<page>(spiderdb_error{error_code::page_unavailable});
     }
     auto page_it = _pages.find(id);
-    if (page_it != _pages.end() && page_it->second) {
+    if (page_it != _pages.end() && page_it->second && page_it->second->get_size() == page_size) {
         return seastar::make_ready_future<page>(page_it->second->shared_from_this());
     }
-    page new_page{id, _config};
+    page new_page{id, page_size, _config, _page_frame_arena.weak_from_this()};
     new_page.set_header(get_new_page_header());
-    _pages.emplace(id, new_page.get_pointer());
+    add_page(new_page);
     return new_page.load(_file).then([new_page] {
         return seastar::make_ready_future<page>(new_page);
     });
 }
 
+page file_impl::create_page(page_id id, uint32_t page_size) {
+    // Used for pages that are about to be overwritten, so nothing is read from disk
+    auto page_it = _pages.find(id);
+    if (page_it != _pages.end() && page_it->second && page_it->second->get_size() == page_size) {
+        return page{page_it->second->shared_from_this()};
+    }
+    page new_page{id, page_size, _config, _page_frame_arena.weak_from_this()};
+    new_page.set_header(get_new_page_header());
+    add_page(new_page);
+    return new_page;
+}
+
+void file_impl::add_page(const page& new_page) {
+    _pages.insert_or_assign(new_page.get_id(), new_page.get_pointer());
+    if (_pages.size() >= _page_sweep_threshold) {
+        // Drop the entries of pages that are gone, so the map stays proportional to the resident pages
+        for (auto it = _pages.begin(); it != _pages.end();) {
+            it = it->second ? std::next(it) : _pages.erase(it);
+        }
+        _page_sweep_threshold = std::max<size_t>(_pages.size() * 2, 1 << 10);
+    }
+    _buffer_manager.check_budget();
+}
+
+page_id file_impl::allocate_pages(uint64_t count) {
+    auto first = _free_space_map.allocate(count);
+    if (first == null_page) {
+        // Grow the file by a whole chunk and keep the rest of it as free space
+        const auto chunk = std::max<uint64_t>(count, _config.file_growth_chunk_pages);
+        first = grow(chunk);
+        release_pages(first + page_id{static_cast<page_id::underlying_type>(count)}, chunk - count);
+    }
+    if (_punched_tail > 0 && first.get() + count > _punched_tail) {
+        _punched_tail = 0;
+    }
+    _file_header->_dirty = true;
+    return first;
+}
+
+void file_impl::release_pages(page_id first, uint64_t count) {
+    if (first == null_page || count == 0) {
+        return;
+    }
+    _free_space_map.release(first, count);
+    _file_header->_dirty = true;
+    // Free pages need not be written back, and they may be reused by pages of another size
+    discard_dirty_pages(first, count);
+}
+
+page_id file_impl::grow(uint64_t count) {
+    auto first = page_id{static_cast<page_id::underlying_type>(_file_header->_page_count)};
+    _file_header->_page_count += count;
+    _file_header->_dirty = true;
+    // Reserved on disk before the next writeback pass
+    _preallocations.emplace_back(_config.file_header_size + first.get() * _config.page_size, count * _config.page_size);
+    return first;
+}
+
+seastar::future<> file_impl::preallocate() {
+    if (_preallocations.empty()) {
+        return seastar::now();
+    }
+    return seastar::do_with(std::exchange(_preallocations, {}), [this](auto& preallocations) {
+        return seastar::do_for_each(preallocations, [this](auto& range) {
+            return _file.allocate(range.first, range.second).handle_exception([range](auto ex) {
+                // Not supported by every file system, and pages are still written on demand
+                SPIDERDB_LOGGER_DEBUG("Failed to preallocate {} bytes at {}: {}", range.second, range.first, ex);
+            });
+        });
+    });
+}
+
+seastar::future<> file_impl::punch_free_tail() {
+    if (!_config.punch_free_tail) {
+        return seastar::now();
+    }
+    const auto free_tail = _free_space_map.get_free_tail(_file_header->_page_count);
+    if (free_tail == null_page) {
+        return seastar::now();
+    }
+    // Keep one growth chunk allocated for upcoming writes
+    const uint64_t first = free_tail.get() + _config.file_growth_chunk_pages;
+    if (first >= _file_header->_page_count || first == _punched_tail) {
+        return seastar::now();
+    }
+    _punched_tail = first;
+    discard_dirty_pages(page_id{static_cast<page_id::underlying_type>(first)}, _file_header->_page_count - first);
+    const auto offset = _config.file_header_size + first * _config.page_size;
+    const auto length = (_file_header->_page_count - first) * _config.page_size;
+    return _file.discard(offset, length).handle_exception([offset, length](auto ex) {
+        SPIDERDB_LOGGER_DEBUG("Failed to punch {} bytes at {}: {}", length, offset, ex);
+    });
+}
+
+uint64_t file_impl::get_page_span(uint32_t page_size) const noexcept {
+    return (page_size + _config.page_size - 1) / _config.page_size;
+}
+
+bool file_impl::is_valid_page_size(uint32_t page_size) const noexcept {
+    // Frames are written back as runs of whole units, so a page must fill the units it spans
+    return page_size > 0 && page_size % _config.page_size == 0;
+}
+
+uint64_t file_impl::get_overflow_page_count(uint32_t record_len, uint32_t page_size) const noexcept {
+    const uint64_t work_size = page_size - _config.page_header_size;
+    if (record_len <= work_size) {
+        return 0;
+    }
+    return (record_len - work_size + work_size - 1) / work_size;
+}
+
+seastar::future<> file_impl::load_free_space_map() {
+    _free_space_map = free_space_map{};
+    if (_file_header->_free_space_page == null_page) {
+        return seastar::now();
+    }
+    return read(_file_header->_free_space_page).then([this](auto data) {
+        return _free_space_map.write(seastar::temporary_buffer<char>{data.c_str(), data.length()});
+    });
+}
+
+seastar::future<> file_impl::flush_free_space_map() {
+    if (!_free_space_map.is_dirty()) {
+        return seastar::now();
+    }
+    const auto required_page_count = get_overflow_page_count(_free_space_map.size(), _config.page_size) + 1;
+    if (required_page_count > _file_header->_free_space_page_count) {
+        // Move the map to a larger run at the end of the file, leaving room for it to grow. The map is
+        // never stored in pages it tracks, so flushing it cannot change its own content.
+        auto old_free_space_page = _file_header->_free_space_page;
+        auto old_free_space_page_count = _file_header->_free_space_page_count;
+        _file_header->_free_space_page_count = required_page_count * 2;
+        _file_header->_free_space_page = grow(_file_header->_free_space_page_count);
+        release_pages(old_free_space_page, old_free_space_page_count);
+    }
+    seastar::temporary_buffer<char> buffer{_free_space_map.size()};
+    return _free_space_map.read(buffer.share()).then([this, buffer{buffer.share()}] {
+        _free_space_map.mark_clean();
+        auto first = create_page(_file_header->_free_space_page, _config.page_size);
+        first.set_type(page_type::free_space);
+        auto next = _file_header->_free_space_page + page_id{1};
+        return write_pages(first, next, string{buffer.get(), buffer.size()});
+    });
+}
+
+seastar::future<> file_impl::mark_page_dirty(page dirty_page) {
+    auto dirty_page_it = _dirty_pages.find(dirty_page.get_id());
+    if (dirty_page_it != _dirty_pages.end()) {
+        _buffer_manager.remove_dirty_bytes(dirty_page_it->second.get_size());
+        _dirty_pages.erase(dirty_page_it);
+    }
+    _dirty_pages.emplace(dirty_page.get_id(), dirty_page);
+    _buffer_manager.add_dirty_bytes(dirty_page.get_size());
+    if (_buffer_manager.get_dirty_bytes() <= get_dirty_threshold()) {
+        return seastar::now();
+    }
+    _writeback_cond.signal();
+    if (_no_steal) {
+        // Only a checkpoint cleans the pages, and it waits for the operation in progress, so writers are throttled
+        // before they start instead
+        return seastar::now();
+    }
+    return throttle_writes();
+}
+
+seastar::future<> file_impl::throttle_writes() {
+    const auto max_dirty_bytes = static_cast<uint64_t>(get_dirty_threshold() * _config.max_dirty_ratio / _config.dirty_ratio);
+    if (_buffer_manager.get_dirty_bytes() <= max_dirty_bytes || _writeback_stopped) {
+        return seastar::now();
+    }
+    _writeback_cond.signal();
+    // Throttle writers until writeback catches up
+    return _writeback_done.wait([this, max_dirty_bytes] {
+        return _buffer_manager.get_dirty_bytes() <= max_dirty_bytes || _writeback_stopped;
+    });
+}
+
+void file_impl::discard_dirty_pages(page_id first, uint64_t count) {
+    const auto last = first + page_id{static_cast<page_id::underlying_type>(count)};
+    for (auto it = _dirty_pages.lower_bound(first); it != _dirty_pages.end() && it->first < last;) {
+        _buffer_manager.remove_dirty_bytes(it->second.get_size());
+        it = _dirty_pages.erase(it);
+    }
+}
+
+void file_impl::start_writeback() {
+    _writeback_stopped = false;
+    _writeback = seastar::with_scheduling_group(_config.writeback_scheduling_group, [this] {
+        return seastar::do_until([this] {
+            return _writeback_stopped;
+        }, [this] {
+            return _writeback_cond.wait(_config.writeback_interval, [this] {
+                return _writeback_stopped || _buffer_manager.get_dirty_bytes() > get_dirty_threshold();
+            }).then_wrapped([this](auto f) {
+                const bool timed_out = f.failed();
+                if (timed_out) {
+                    f.ignore_ready_future();
+                }
+                if (_no_steal) {
+                    if (_writeback_stopped || _dirty_pages.empty()) {
+                        return seastar::now();
+                    }
+                    // Pages only reach the disk with a checkpoint
+                    return checkpoint().handle_exception([](auto ex) {
+                        SPIDERDB_LOGGER_ERROR("Failed to checkpoint: {}", ex);
+                    });
+                }
+                // Triggered by the writeback interval or by the dirty ratio
+                return write_back(timed_out ? 0 : get_dirty_threshold() / 2).handle_exception([](auto ex) {
+                    SPIDERDB_LOGGER_ERROR("Failed to write back: {}", ex);
+                });
+            });
+        });
+    }).handle_exception([this](auto ex) {
+        SPIDERDB_LOGGER_ERROR("Writeback stopped: {}", ex);
+    });
+}
+
+seastar::future<> file_impl::stop_writeback() {
+    _writeback_stopped = true;
+    _writeback_cond.broadcast();
+    _writeback_done.broadcast();
+    return std::exchange(_writeback, seastar::make_ready_future<>());
+}
+
+seastar::future<> file_impl::write_back(uint64_t max_dirty_bytes) {
+    return seastar::with_semaphore(_writeback_lock, 1, [this, max_dirty_bytes] {
+        return preallocate().then([this, max_dirty_bytes] {
+            // Passes that failed in a row, and the error of the last failed write
+            return seastar::do_with(uint32_t{0}, std::exception_ptr{}, [this, max_dirty_bytes](auto& n_failed_passes, auto& error) {
+                return seastar::do_until([this, max_dirty_bytes] {
+                    return _dirty_pages.empty() || _buffer_manager.get_dirty_bytes() <= max_dirty_bytes;
+                }, [this, &n_failed_passes, &error] {
+                    // Sweep the dirty pages in file-offset order and group contiguous ones into a single write
+                    std::vector<std::vector<page>> runs;
+                    size_t n_pages = 0;
+                    auto get_end = [this](const page& page) {
+                        return page.get_id() + page_id{static_cast<page_id::underlying_type>(get_page_span(page.get_size()))};
+                    };
+                    auto it = _dirty_pages.lower_bound(_writeback_cursor);
+                    while (!_dirty_pages.empty() && n_pages < _config.max_pages_per_writeback) {
+                        if (it == _dirty_pages.end()) {
+                            it = _dirty_pages.begin();
+                        }
+                        if (runs.empty() || get_end(runs.back().back()) != it->first) {
+                            runs.emplace_back();
+                        }
+                        _writeback_cursor = get_end(it->second);
+                        _buffer_manager.remove_dirty_bytes(it->second.get_size());
+                        runs.back().push_back(std::move(it->second));
+                        it = _dirty_pages.erase(it);
+                        ++n_pages;
+                    }
+                    const auto n_runs = runs.size();
+                    return seastar::do_with(size_t{0}, [this, runs{std::move(runs)}, &error](auto& n_failed_runs) mutable {
+                        return seastar::parallel_for_each(std::move(runs), [this, &n_failed_runs, &error](auto& run) {
+                            return write_dirty_pages(std::move(run)).handle_exception([&n_failed_runs, &error](auto ex) {
+                                ++n_failed_runs;
+                                error = ex;
+                            });
+                        }).then([&n_failed_runs] {
+                            return n_failed_runs;
+                        });
+                    }).then([this, n_runs, &n_failed_passes, &error](auto n_failed_runs) {
+                        if (n_failed_runs < n_runs) {
+                            n_failed_passes = 0;
+                            return seastar::now();
+                        }
+                        // Nothing was written, so give up on an error that persists rather than retry it forever
+                        if (++n_failed_passes > _config.max_writeback_retries) {
+                            return seastar::make_exception_future<>(error);
+                        }
+                        return seastar::sleep(_config.writeback_retry_delay * (1u << (n_failed_passes - 1)));
+                    }).finally([this] {
+                        _writeback_done.broadcast();
+                    });
+                });
+            });
+        });
+    });
+}
+
+seastar::future<> file_impl::write_dirty_pages(std::vector<page> pages) {
+    return seastar::do_with(std::move(pages), std::vector<seastar::temporary_buffer<char>>{}, [this](auto& pages, auto& frames) {
+        return seastar::do_with(uint64_t{0}, [this, &pages, &frames](auto& lsn) {
+            // Written from copies, as the frames stay open to writes during the DMA
+            return seastar::do_for_each(pages, [&frames, &lsn](auto& page) {
+                return page.snapshot().then([&frames, &lsn, page](auto frame) {
+                    // Read after the copy, so it covers at least the changes in it
+                    lsn = std::max(lsn, page.get_lsn());
+                    frames.push_back(std::move(frame));
+                });
+            }).then([this, &lsn] {
+                // The log must reach the disk before the pages it covers
+                return sync_log(lsn);
+            });
+        }).then([this, &pages, &frames] {
+            std::vector<iovec> iov;
+            iov.reserve(frames.size());
+            for (auto& frame : frames) {
+                iov.push_back(iovec{frame.get_write(), frame.size()});
+            }
+            return _file.dma_write(pages.front().get_offset(), std::move(iov), _config.writeback_priority_class).discard_result();
+        }).handle_exception([this, &pages](auto ex) {
+            // Keep the pages dirty so that a later pass retries them
+            SPIDERDB_LOGGER_ERROR("Failed to write back {} pages from {:0>12}: {}", pages.size(), pages.front().get_id(), ex);
+            for (auto& page : pages) {
+                if (_dirty_pages.emplace(page.get_id(), page).second) {
+                    _buffer_manager.add_dirty_bytes(page.get_size());
+                }
+            }
+            return seastar::make_exception_future<>(ex);
+        });
+    });
+}
+
+uint64_t file_impl::get_dirty_threshold() const noexcept {
+    return static_cast<uint64_t>(_buffer_manager.get_budget() * _config.dirty_ratio);
+}
+
+std::string file_impl::get_double_write_file_name() const {
+    return fmt::format("{}.dwb", _name);
+}
+
+seastar::future<> file_impl::write_double_write_buffer() {
+    // Laid out as a checksum, the length it covers, the image count, then an offset, a length and the bytes of each
+    // image. The header goes along with the pages, as it refers to them.
+    using image = std::pair<uint64_t, seastar::temporary_buffer<char>>;
+    std::vector<page> pages;
+    pages.reserve(_dirty_pages.size());
+    for (const auto& item : _dirty_pages) {
+        pages.push_back(item.second);
+    }
+    return seastar::do_with(std::move(pages), std::vector<image>{}, uint64_t{0}, [this](auto& pages, auto& images, auto& lsn) {
+        seastar::temporary_buffer<char> header{_file_header->_size};
+        return _file_header->read(header.share()).then([&pages, &images, &lsn, header{header.share()}]() mutable {
+            images.emplace_back(0, std::move(header));
+            return seastar::do_for_each(pages, [&images, &lsn](auto& page) {
+                return page.snapshot().then([&images, &lsn, page](auto frame) {
+                    lsn = std::max(lsn, page.get_lsn());
+                    images.emplace_back(page.get_offset(), std::move(frame));
+                });
+            });
+        }).then([this, &lsn] {
+            // The log must reach the disk before the pages it covers
+            return sync_log(lsn);
+        }).then([this, &images] {
+            const auto flags = seastar::open_flags::create | seastar::open_flags::truncate | seastar::open_flags::wo;
+            return seastar::open_file_dma(get_double_write_file_name(), flags).then([&images](auto file) {
+                uint64_t len = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t);
+                for (const auto& image : images) {
+                    len += sizeof(uint64_t) + sizeof(uint64_t) + image.second.size();
+                }
+                const uint64_t alignment = file.disk_write_dma_alignment();
+                const uint64_t aligned_len = (len + alignment - 1) / alignment * alignment;
+                auto buffer = seastar::temporary_buffer<char>::aligned(file.memory_dma_alignment(), aligned_len);
+                memset(buffer.get_write(), 0, aligned_len);
+                auto pos = buffer.get_write() + sizeof(uint32_t);
+                memcpy(pos, &len, sizeof(len));
+                pos += sizeof(len);
+                const uint64_t count = images.size();
+                memcpy(pos, &count, sizeof(count));
+                pos += sizeof(count);
+                for (const auto& image : images) {
+                    const uint64_t image_len = image.second.size();
+                    memcpy(pos, &image.first, sizeof(image.first));
+                    pos += sizeof(image.first);
+                    memcpy(pos, &image_len, sizeof(image_len));
+                    pos += sizeof(image_len);
+                    memcpy(pos, image.second.get(), image_len);
+                    pos += image_len;
+                }
+                const auto checksum = get_checksum(buffer.get() + sizeof(uint32_t), len - sizeof(uint32_t));
+                memcpy(buffer.get_write(), &checksum, sizeof(checksum));
+                auto data = buffer.get();
+                return file.dma_write(0, data, aligned_len).then([file](auto) mutable {
+                    return file.flush();
+                }).finally([file, buffer{std::move(buffer)}]() mutable {
+                    return file.close().finally([file] {});
+                });
+            });
+        });
+    });
+}
+
+seastar::future<> file_impl::recover_double_write_buffer() {
+    auto name = get_double_write_file_name();
+    return seastar::file_exists(name).then([this, name](auto exists) {
+        if (!exists) {
+            return seastar::now();
+        }
+        return seastar::open_file_dma(name, seastar::open_flags::ro).then([](auto file) {
+            return file.size().then([file](auto size) mutable {
+                return file.dma_read_bulk<char>(0, size);
+            }).finally([file]() mutable {
+                return file.close().finally([file] {});
+            });
+        }).then([this](auto buffer) {
+            const size_t prefix_len = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t);
+            uint32_t checksum = 0;
+            uint64_t len = 0;
+            if (buffer.size() >= prefix_len) {
+                memcpy(&checksum, buffer.begin(), sizeof(checksum));
+                memcpy(&len, buffer.begin() + sizeof(checksum), sizeof(len));
+            }
+            if (len < prefix_len || len > buffer.size() || checksum != get_checksum(buffer.begin() + sizeof(uint32_t), len - sizeof(uint32_t))) {
+                // Torn before any page was written in place, so the file still holds the previous checkpoint
+                SPIDERDB_LOGGER_WARN("Discarded a torn double-write buffer");
+                return seastar::now();
+            }
+            uint64_t count;
+            memcpy(&count, buffer.begin() + sizeof(checksum) + sizeof(len), sizeof(count));
+            buffer.trim(len);
+            buffer.trim_front(prefix_len);
+            std::vector<std::pair<uint64_t, seastar::temporary_buffer<char>>> images;
+            for (uint64_t i = 0; i < count && buffer.size() >= sizeof(uint64_t) + sizeof(uint64_t); ++i) {
+                uint64_t offset;
+                memcpy(&offset, buffer.begin(), sizeof(offset));
+                buffer.trim_front(sizeof(offset));
+                uint64_t image_len;
+                memcpy(&image_len, buffer.begin(), sizeof(image_len));
+                buffer.trim_front(sizeof(image_len));
+                image_len = std::min<uint64_t>(image_len, buffer.size());
+                auto image = seastar::temporary_buffer<char>::aligned(_file.memory_dma_alignment(), image_len);
+                memcpy(image.get_write(), buffer.begin(), image_len);
+                buffer.trim_front(image_len);
+                images.emplace_back(offset, std::move(image));
+            }
+            return seastar::do_with(std::move(images), [this](auto& images) {
+                return seastar::do_for_each(images, [this](auto& image) {
+                    return _file.dma_write(image.first, image.second.get(), image.second.size()).discard_result();
+                }).then([this] {
+                    return _file.flush();
+                }).then([&images] {
+                    SPIDERDB_LOGGER_INFO("Recovered {} pages from the double-write buffer", images.size() - 1);
+                });
+            });
+        }).then([name] {
+            return seastar::remove_file(name);
+        });
+    });
+}
+
+seastar::future<> file_impl::remove_double_write_buffer() {
+    auto name = get_double_write_file_name();
+    return seastar::file_exists(name).then([name](auto exists) {
+        if (!exists) {
+            return seastar::now();
+        }
+        return seastar::remove_file(name);
+    });
+}
+
 file::file(std::string name, spiderdb_config config) {
     _impl = seastar::make_lw_shared<file_impl>(std::move(name), config);
 }
@@ -342,6 +1045,13 @@ seastar::future<string> file::read(page_id id) const {
     return _impl->read(id);
 }
 
+seastar::future<> file::unlink(page_id id) const {
+    if (!_impl || !_impl->is_open()) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return _impl->unlink_pages_from(id);
+}
+
 void file::log() const {
     if (!_impl || !_impl->is_open()) {
         throw spiderdb_error{error_code::closed_error};
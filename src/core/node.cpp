@@ -8,11 +8,40 @@
 
 namespace spiderdb {
 
+namespace {
+
+uint64_t get_key_head(const char* data, size_t len) noexcept {
+    // Comparing heads as integers orders keys like memcmp, and shorter keys are padded with zeros
+    uint64_t head = 0;
+    const auto head_len = std::min(len, sizeof(head));
+    for (size_t i = 0; i < head_len; ++i) {
+        head |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (56 - 8 * i);
+    }
+    return head;
+}
+
+bool has_child(const node& parent, node_id child) {
+    const auto& pointers = parent.get_pointer_list();
+    return std::any_of(pointers.begin(), pointers.end(), [child](const auto& pointer) {
+        return pointer.child == child;
+    });
+}
+
+string get_separator(const string& left, const string& right) {
+    // The shortest prefix of right that is still greater than left
+    size_t len = 0;
+    const auto min_len = std::min(left.length(), right.length());
+    while (len < min_len && left.c_str()[len] == right.c_str()[len]) {
+        ++len;
+    }
+    return string{right.c_str(), std::min(len + 1, right.length())};
+}
+
+}
+
 seastar::future<> node_header::write(seastar::temporary_buffer<char> buffer) {
     return page_header::write(buffer.share()).then([this, buffer{buffer.share()}]() mutable {
         buffer.trim_front(page_header::size());
-        memcpy(&_parent, buffer.begin(), sizeof(_parent));
-        buffer.trim_front(sizeof(_parent));
         memcpy(&_key_count, buffer.begin(), sizeof(_key_count));
         buffer.trim_front(sizeof(_key_count));
         memcpy(&_prefix_len, buffer.begin(), sizeof(_prefix_len));
@@ -24,8 +53,6 @@ seastar::future<> node_header::write(seastar::temporary_buffer<char> buffer) {
 seastar::future<> node_header::read(seastar::temporary_buffer<char> buffer) {
     return page_header::read(buffer.share()).then([this, buffer{buffer.share()}]() mutable {
         buffer.trim_front(page_header::size());
-        memcpy(buffer.get_write(), &_parent, sizeof(_parent));
-        buffer.trim_front(sizeof(_parent));
         memcpy(buffer.get_write(), &_key_count, sizeof(_key_count));
         buffer.trim_front(sizeof(_key_count));
         memcpy(buffer.get_write(), &_prefix_len, sizeof(_prefix_len));
@@ -38,21 +65,13 @@ void node_header::log() const noexcept {
     page_header::log();
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Number of keys: ", _key_count);
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Prefix length: ", _prefix_len);
-    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Parent node: ", _parent);
 }
 
-node_impl::node_impl(page page, seastar::weak_ptr<btree_impl>&& btree, seastar::weak_ptr<node_impl>&& parent)
+node_impl::node_impl(page page, seastar::weak_ptr<btree_impl>&& btree)
         : _id{node_id{static_cast<node_id::underlying_type>(page.get_id().get())}}, _page{std::move(page)} {
     if (btree) {
         _btree = std::move(btree);
         _header = seastar::dynamic_pointer_cast<node_header>(_page.get_header());
-        _parent = std::move(parent);
-        if (_parent) {
-            if (_parent->_id != _header->_parent) {
-                _header->_parent = _parent->_id;
-                _dirty = true;
-            }
-        }
         calculate_data_length();
     }
 }
@@ -64,65 +83,16 @@ seastar::future<> node_impl::load() {
     if (_loaded) {
         return seastar::now();
     }
+    if (_page.get_next_page() == null_page) {
+        // A node without overflow pages is decoded straight from the page frame
+        auto frame = _page.get_frame();
+        decode(frame.get() + _btree->_config.page_header_size);
+        calculate_data_length();
+        _loaded = true;
+        return seastar::now();
+    }
     return _btree->read(_page).then([this](auto&& data) {
-        auto&& is = data.get_input_stream();
-        // Load prefix
-        char prefix_byte_arr[_header->_prefix_len];
-        if (_header->_prefix_len > 0) {
-            is.read(prefix_byte_arr, _header->_prefix_len);
-            _prefix = std::move(string{prefix_byte_arr, _header->_prefix_len});
-        }
-        // Load keys
-        for (uint32_t i = 0; i < _header->_key_count; ++i) {
-            // Load key length
-            uint32_t key_len;
-            char key_len_byte_arr[sizeof(key_len)];
-            is.read(key_len_byte_arr, sizeof(key_len));
-            memcpy(&key_len, key_len_byte_arr, sizeof(key_len));
-            // Load key
-            char full_key_byte_arr[_header->_prefix_len + key_len];
-            if (_header->_prefix_len > 0) {
-                memcpy(full_key_byte_arr, _prefix.c_str(), _prefix.length());
-            }
-            if (key_len > 0) {
-                char key_byte_arr[key_len];
-                is.read(key_byte_arr, key_len);
-                memcpy(full_key_byte_arr + _header->_prefix_len, key_byte_arr, key_len);
-            }
-            string full_key{full_key_byte_arr, static_cast<size_t>(_header->_prefix_len + key_len)};
-            _keys.push_back(std::move(full_key));
-        }
-        // Load pointers
-        uint32_t pointer_count = _header->_key_count + (_page.get_type() == node_type::internal ? 1 : 0);
-        node_item_pointer::largest_type current_pointer;
-        char current_pointer_byte_arr[sizeof(current_pointer)];
-        for (uint32_t i = 0; i < pointer_count; ++i) {
-            is.read(current_pointer_byte_arr, sizeof(current_pointer));
-            memcpy(&current_pointer, current_pointer_byte_arr, sizeof(current_pointer));
-            if (_page.get_type() == node_type::internal) {
-                _pointers.push_back(node_item_pointer{.child = node_id{static_cast<node_id::underlying_type>(current_pointer)}});
-            } else {
-                _pointers.push_back(node_item_pointer{.pointer = value_pointer{static_cast<value_pointer::underlying_type>(current_pointer)}});
-            }
-        }
-        // Load high key length
-        uint32_t high_key_len;
-        char high_key_len_byte_arr[sizeof(high_key_len)];
-        is.read(high_key_len_byte_arr, sizeof(high_key_len));
-        memcpy(&high_key_len, high_key_len_byte_arr, sizeof(high_key_len));
-        if (high_key_len > 0) {
-            // Load high key
-            char high_key_byte_arr[high_key_len];
-            is.read(high_key_byte_arr, high_key_len);
-            _high_key = std::move(string{high_key_byte_arr, high_key_len});
-        }
-        // Load siblings
-        char sibling_byte_arr[sizeof(node_id)];
-        is.read(sibling_byte_arr, sizeof(node_id));
-        memcpy(&_prev, sibling_byte_arr, sizeof(node_id));
-        is.read(sibling_byte_arr, sizeof(node_id));
-        memcpy(&_next, sibling_byte_arr, sizeof(node_id));
-        // Mark as loaded
+        decode(data.c_str());
         calculate_data_length();
         _loaded = true;
     });
@@ -139,48 +109,10 @@ seastar::future<> node_impl::flush() {
         return seastar::now();
     }
     calculate_data_length();
-    string data{_data_len, 0};
-    seastar::simple_memory_output_stream os{data.str(), data.length()};
-    // Flush prefix
-    if (_prefix.length() > 0) {
-        os.write(_prefix.c_str(), _prefix.length());
-    }
-    // Flush keys
-    for (size_t i = 0; i < _keys.size(); ++i) {
-        // Flush key length
-        uint32_t key_len = _keys[i].length() - _prefix.length();
-        char key_len_byte_arr[sizeof(key_len)];
-        memcpy(key_len_byte_arr, &key_len, sizeof(key_len));
-        os.write(key_len_byte_arr, sizeof(key_len));
-        if (key_len > 0) {
-            // Flush key
-            os.write(_keys[i].c_str() + _prefix.length(), key_len);
-        }
-    }
-    // Flush pointers
-    char current_pointer_byte_arr[sizeof(node_item_pointer)];
-    for (size_t i = 0; i < _pointers.size(); ++i) {
-        memcpy(current_pointer_byte_arr, &_pointers[i], sizeof(node_item_pointer));
-        os.write(current_pointer_byte_arr, sizeof(node_item_pointer));
-    }
-    // Flush high key length
-    uint32_t high_key_len = _high_key.length();
-    char high_key_len_byte_arr[sizeof(high_key_len)];
-    memcpy(high_key_len_byte_arr, &high_key_len, sizeof(high_key_len));
-    os.write(high_key_len_byte_arr, sizeof(high_key_len));
-    if (high_key_len > 0) {
-        // Flush high key
-        os.write(_high_key.c_str(), high_key_len);
-    }
-    // Flush siblings
-    char sibling_byte_arr[sizeof(node_id)];
-    memcpy(sibling_byte_arr, &_prev, sizeof(node_id));
-    os.write(sibling_byte_arr, sizeof(node_id));
-    memcpy(sibling_byte_arr, &_next, sizeof(node_id));
-    os.write(sibling_byte_arr, sizeof(node_id));
-    return _btree->write(_page, std::move(data)).then([this] {
+    return _btree->write(_page, _data_len, [this](char* data) {
+        encode(data);
+    }).then([this] {
         // Mark as flushed
-        _parent = nullptr;
         _dirty = false;
     });
 }
@@ -189,33 +121,10 @@ seastar::future<> node_impl::add(string&& key, value_pointer ptr) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
-    return seastar::with_semaphore(_lock, 1, [this, key{std::move(key)}, ptr]() mutable {
-        auto id = binary_search(key, 0, _keys.size() - 1);
-        switch (_page.get_type()) {
-            case node_type::internal: {
-                id = (id < 0) ? - (id + 1) : (id + 1);
-                return get_child(id).then([key, ptr](auto child) mutable {
-                    return child.add(std::move(key), ptr);
-                });
-            }
-            case node_type::leaf: {
-                if (id >= 0) {
-                    return seastar::make_exception_future<>(spiderdb_error{error_code::key_exists});
-                }
-                id = - (id + 1);
-                _keys.insert(_keys.begin() + id, key);
-                _pointers.insert(_pointers.begin() + id, node_item_pointer{.pointer = ptr});
-                update_metadata();
-                _data_len += key.length() + sizeof(uint32_t) + sizeof(node_item_pointer);
-                if (!need_split()) {
-                    return seastar::now();
-                }
-                return split();
-            }
-            default: {
-                return seastar::make_exception_future<>(spiderdb_error{error_code::page_type_incorrect});
-            }
-        }
+    return seastar::get_units(_lock, 1).then([this, key{std::move(key)}, ptr](auto units) mutable {
+        latch_list latches;
+        latches.push_back(std::move(units));
+        return add(std::move(key), ptr, std::move(latches), node_path{});
     }).then([this] {
         return cache(shared_from_this());
     });
@@ -225,51 +134,164 @@ seastar::future<value_pointer> node_impl::remove(string&& key) {
     if (!is_valid()) {
         return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::node_unavailable});
     }
-    return seastar::with_semaphore(_lock, 1, [this, key{std::move(key)}]() mutable {
-        auto id = binary_search(key, 0, _keys.size() - 1);
-        switch (_page.get_type()) {
-            case node_type::internal: {
-                id = (id < 0) ? - (id + 1) : (id + 1);
-                return get_child(id).then([key](auto child) mutable {
-                    return child.remove(std::move(key));
+    return seastar::get_units(_lock, 1).then([this, key{std::move(key)}](auto units) mutable {
+        latch_list latches;
+        latches.push_back(std::move(units));
+        return remove(std::move(key), std::move(latches), node_path{});
+    }).then([this](auto result) {
+        return cache(shared_from_this()).then([result] {
+            return seastar::make_ready_future<value_pointer>(result);
+        });
+    });
+}
+
+seastar::future<> node_impl::add(string&& key, value_pointer ptr, latch_list&& latches, node_path&& path) {
+    // Holds the latches of this node and of the ancestors that a split may still reach, and the path to them
+    auto id = binary_search(key, 0, _keys.size() - 1);
+    switch (_page.get_type()) {
+        case node_type::internal: {
+            id = (id < 0) ? - (id + 1) : (id + 1);
+            path.push_back(shared_from_this());
+            return get_child(id).then([this, key{std::move(key)}, ptr, latches{std::move(latches)}, path{std::move(path)}](auto child) mutable {
+                return seastar::get_units(child.get_pointer()->_lock, 1).then([this, key{std::move(key)}, ptr, latches{std::move(latches)}, path{std::move(path)}, child](auto units) mutable {
+                    auto child_impl = child.get_pointer();
+                    if (child_impl->is_safe_for_add(key)) {
+                        latches.clear();
+                        path.clear();
+                    }
+                    latches.push_back(std::move(units));
+                    return child_impl->add(std::move(key), ptr, std::move(latches), std::move(path)).then([this, child] {
+                        return cache(child);
+                    });
                 });
+            });
+        }
+        case node_type::leaf: {
+            if (id >= 0) {
+                return seastar::make_exception_future<>(spiderdb_error{error_code::key_exists});
             }
-            case node_type::leaf: {
-                if (id < 0) {
-                    return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::key_not_exists});
-                }
-                auto result = _pointers[id].pointer;
-                _keys.erase(_keys.begin() + id);
-                _pointers.erase(_pointers.begin() + id);
-                update_metadata();
-                _data_len -= key.length() + sizeof(uint32_t) + sizeof(node_item_pointer);
-                return seastar::futurize_invoke([this] {
-                    if (need_destroy()) {
-                        return destroy();
-                    } else if (need_merge()) {
-                        return merge();
-                    } else {
-                        return seastar::now();
+            // A leaf dropped its path only if the key cannot split it, as a split needs the parent
+            assert(_id == _btree->get_root().get_id() || !path.empty() || is_safe_for_add(key));
+            id = - (id + 1);
+            _keys.insert(_keys.begin() + id, key);
+            _pointers.insert(_pointers.begin() + id, node_item_pointer{.pointer = ptr});
+            update_metadata();
+            _data_len += key.length() + slot_size() + sizeof(node_item_pointer);
+            if (!need_split()) {
+                return seastar::now();
+            }
+            return split(std::move(path)).finally([latches{std::move(latches)}] {});
+        }
+        default: {
+            return seastar::make_exception_future<>(spiderdb_error{error_code::page_type_incorrect});
+        }
+    }
+}
+
+seastar::future<value_pointer> node_impl::remove(string&& key, latch_list&& latches, node_path&& path) {
+    // Holds the latches of this node and of the ancestors that a merge may still reach, and the path to them
+    auto id = binary_search(key, 0, _keys.size() - 1);
+    switch (_page.get_type()) {
+        case node_type::internal: {
+            id = (id < 0) ? - (id + 1) : (id + 1);
+            path.push_back(shared_from_this());
+            return get_child(id).then([this, key{std::move(key)}, latches{std::move(latches)}, path{std::move(path)}](auto child) mutable {
+                return seastar::get_units(child.get_pointer()->_lock, 1).then([this, key{std::move(key)}, latches{std::move(latches)}, path{std::move(path)}, child](auto units) mutable {
+                    auto child_impl = child.get_pointer();
+                    if (child_impl->is_safe_for_remove(key)) {
+                        latches.clear();
+                        path.clear();
                     }
-                }).then([result] {
-                    return seastar::make_ready_future<value_pointer>(result);
+                    latches.push_back(std::move(units));
+                    return child_impl->remove(std::move(key), std::move(latches), std::move(path)).then([this, child](auto result) {
+                        return cache(child).then([result] {
+                            return seastar::make_ready_future<value_pointer>(result);
+                        });
+                    });
                 });
+            });
+        }
+        case node_type::leaf: {
+            if (id < 0) {
+                return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::key_not_exists});
             }
-            default: {
-                return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::page_type_incorrect});
-            }
+            // A leaf dropped its path only if losing the key cannot merge or destroy it, as both need the parent
+            assert(_id == _btree->get_root().get_id() || !path.empty() || is_safe_for_remove(key));
+            auto result = _pointers[id].pointer;
+            _keys.erase(_keys.begin() + id);
+            _pointers.erase(_pointers.begin() + id);
+            update_metadata();
+            _data_len -= key.length() + slot_size() + sizeof(node_item_pointer);
+            return seastar::futurize_invoke([this, path{std::move(path)}]() mutable {
+                if (need_destroy()) {
+                    return destroy(std::move(path));
+                } else if (need_merge()) {
+                    return merge(std::move(path));
+                } else {
+                    return seastar::now();
+                }
+            }).then([result] {
+                return seastar::make_ready_future<value_pointer>(result);
+            }).finally([latches{std::move(latches)}] {});
         }
-    }).then([this](auto result) {
-        return cache(shared_from_this()).then([result] {
-            return seastar::make_ready_future<value_pointer>(result);
-        });
-    });
+        default: {
+            return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::page_type_incorrect});
+        }
+    }
+}
+
+bool node_impl::is_safe_for_add(const string& key) {
+    // A leaf takes the key, while an internal node takes at most one separator of the longest allowed length
+    const auto& config = _btree->_config;
+    const auto work_size = _page.get_work_size();
+    const size_t key_len = (_page.get_type() == node_type::leaf) ? key.length() : work_size / config.min_keys_on_each_node;
+    if (_keys.size() + 1 < config.min_keys_on_each_node) {
+        return true;
+    }
+    if (_keys.size() + 1 > config.max_keys_on_each_node) {
+        return false;
+    }
+    // A key that lands before the first key or after the last one may shorten the prefix and grow every key with it
+    if (_keys.empty() || key < _keys.front() || key >= _keys.back()) {
+        return false;
+    }
+    calculate_data_length();
+    return _data_len + key_len + slot_size() + sizeof(node_item_pointer) <= work_size;
+}
+
+bool node_impl::is_safe_for_remove(const string& key) {
+    // A leaf loses the key, while an internal node loses at most one separator of the longest allowed length
+    const auto& config = _btree->_config;
+    const auto work_size = _page.get_work_size();
+    const size_t key_len = (_page.get_type() == node_type::leaf) ? key.length() : work_size / config.min_keys_on_each_node;
+    if (_keys.size() <= 1 || _keys.size() - 1 < config.min_keys_on_each_node / 2) {
+        return false;
+    }
+    // Losing the first or the last key may lengthen the prefix and shrink every key with it. An internal node loses
+    // the separator on either side of the child the key goes to.
+    const auto last = static_cast<int64_t>(_keys.size()) - 1;
+    auto id = binary_search(key, 0, last);
+    if (_page.get_type() == node_type::internal) {
+        id = (id < 0) ? - (id + 1) : (id + 1);
+        if (id <= 1 || id >= last) {
+            return false;
+        }
+    } else if (id == 0 || id == last) {
+        return false;
+    }
+    calculate_data_length();
+    return _data_len >= work_size / 2 + key_len + slot_size() + sizeof(node_item_pointer);
 }
 
 seastar::future<value_pointer> node_impl::find(string&& key) {
     if (!is_valid()) {
         return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::node_unavailable});
     }
+    // Readers take no latch. A node that was merged away while the reader was on its way here sends it back to the
+    // root, and a node that changed while a child was loaded is searched again.
+    if (_cleaned) {
+        return _btree->find(std::move(key));
+    }
     if (_next != null_node && key > _high_key) {
         return _btree->get_node(_next).then([key](auto next) mutable {
             return next.find(std::move(key));
@@ -280,11 +302,15 @@ seastar::future<value_pointer> node_impl::find(string&& key) {
         switch (_page.get_type()) {
             case node_type::internal: {
                 id = (id < 0) ? - (id + 1) : (id + 1);
-                return get_child(id).then([key](auto child) mutable {
+                return get_child(id).then([this, self{shared_from_this()}, key, version{_version}](auto child) mutable {
+                    if (_version != version) {
+                        return find(std::move(key));
+                    }
                     return child.find(std::move(key));
                 });
             }
             case node_type::leaf: {
+                _btree->on_leaf_access(shared_from_this());
                 if (id < 0) {
                     return seastar::make_exception_future<value_pointer>(spiderdb_error{error_code::key_not_exists});
                 }
@@ -301,26 +327,6 @@ seastar::future<value_pointer> node_impl::find(string&& key) {
     });
 }
 
-seastar::future<node> node_impl::get_parent() {
-    if (!is_valid()) {
-        return seastar::make_exception_future<node>(spiderdb_error{error_code::node_unavailable});
-    }
-    if (_parent) {
-        return seastar::make_ready_future<node>(_parent->shared_from_this());
-    }
-    if (_header->_parent == null_node) {
-        return seastar::make_ready_future<node>(nullptr);
-    }
-    if (_header->_parent == _btree->get_root().get_id()) {
-        _parent = std::move(_btree->get_root().get_pointer());
-        return seastar::make_ready_future<node>(_btree->get_root());
-    }
-    return _btree->get_node(_header->_parent).then([this](auto parent) {
-        _parent = std::move(parent.get_pointer());
-        return seastar::make_ready_future<node>(parent);
-    });
-}
-
 seastar::future<node> node_impl::get_child(uint32_t id) {
     if (!is_valid()) {
         return seastar::make_exception_future<node>(spiderdb_error{error_code::node_unavailable});
@@ -331,25 +337,64 @@ seastar::future<node> node_impl::get_child(uint32_t id) {
     if (id < 0 || id >= _pointers.size()) {
         return seastar::make_exception_future<node>(spiderdb_error{error_code::node_child_not_exists});
     }
-    return _btree->get_node(_pointers[id].child, weak_from_this());
-}
-
-void node_impl::update_parent(seastar::weak_ptr<node_impl>&& parent) noexcept {
-    _parent = std::move(parent);
-    if (_parent) {
-        if (_parent->_id != _header->_parent) {
-            _header->_parent = _parent->_id;
-            _dirty = true;
+    // A swizzled child is reached without going through the caches. Slots are not shifted along with _pointers, so
+    // the child is checked against the slot, and a child that has left memory resets its slot by itself.
+    if (id < _children.size()) {
+        auto& child = _children[id];
+        if (child && child->_id == _pointers[id].child && child->_page.get_type() != node_type::unused) {
+            return seastar::make_ready_future<node>(child->shared_from_this());
         }
     }
+    return _btree->get_node(_pointers[id].child).then([this, id](auto child) {
+        if (id < _pointers.size() && _pointers[id].child == child.get_id()) {
+            if (_children.size() < _pointers.size()) {
+                _children.resize(_pointers.size());
+            }
+            _children[id] = child.get_pointer();
+        }
+        return seastar::make_ready_future<node>(child);
+    });
 }
 
 int64_t node_impl::binary_search(const string& key, int64_t low, int64_t high) {
+    // Every key shares the prefix, so a key outside of it falls before or after all of them
+    const auto prefix_len = _prefix.length();
+    if (prefix_len > 0) {
+        const auto len = std::min(key.length(), prefix_len);
+        const auto res = (len > 0) ? memcmp(key.c_str(), _prefix.c_str(), len) : 0;
+        if (res < 0 || (res == 0 && key.length() < prefix_len)) {
+            return - (low + 1);
+        }
+        if (res > 0) {
+            return - (high + 2);
+        }
+    }
+    if (_heads.size() != _keys.size()) {
+        update_heads();
+    }
+    const auto head = get_key_head(key.c_str() + prefix_len, key.length() - prefix_len);
+    if (_fixed_key_len > 0 && key.length() == _fixed_key_len && low <= high) {
+        // The heads order the keys on their own, so search them without branching on the comparisons
+        const auto* base = _heads.data() + low;
+        auto len = high - low + 1;
+        while (len > 1) {
+            const auto half = len / 2;
+            base = (base[half - 1] < head) ? base + half : base;
+            len -= half;
+        }
+        const int64_t id = base - _heads.data();
+        if (*base == head) {
+            return id;
+        }
+        return - ((*base < head) ? id + 2 : id + 1);
+    }
     while (low <= high) {
         int64_t mid = (low + high) / 2;
-        if (key < _keys[mid]) {
+        // Full keys are only compared when the heads tie
+        int res = (head < _heads[mid]) ? -1 : (head > _heads[mid]) ? 1 : key.compare(_keys[mid]);
+        if (res < 0) {
             high = mid - 1;
-        } else if (key > _keys[mid]) {
+        } else if (res > 0) {
             low = mid + 1;
         } else {
             return mid;
@@ -358,10 +403,11 @@ int64_t node_impl::binary_search(const string& key, int64_t low, int64_t high) {
     return - (low + 1);
 }
 
-seastar::future<> node_impl::split() {
+seastar::future<> node_impl::split(node_path&& path) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
+    assert(_id == _btree->get_root().get_id() || !path.empty());
     // Prepare data
     auto midpoint = _header->_key_count / 2;
     std::vector<string> left_keys, right_keys;
@@ -385,38 +431,53 @@ seastar::future<> node_impl::split() {
             return seastar::make_exception_future<>(spiderdb_error{error_code::page_type_incorrect});
         }
     }
+    // Leaves only need a separator between their halves, while the middle key of an internal node bounds whole
+    // subtrees and is promoted as is
+    auto separator = (_page.get_type() == node_type::leaf && midpoint > 0) ? get_separator(_keys[midpoint - 1], _keys[midpoint]) : _keys[midpoint].clone();
     // Split
     if (_id == _btree->get_root().get_id()) {
         return seastar::when_all_succeed(
                 create_node(std::move(left_keys), std::move(left_pointers)),
                 create_node(std::move(right_keys), std::move(right_pointers))
-        ).then([this, midpoint](auto children) {
+        ).then([this, separator{std::move(separator)}](auto children) mutable {
             node left, right;
             std::tie(left, right) = std::move(children);
-            left.set_high_key(_keys[midpoint].clone());
+            left.set_high_key(separator.clone());
             right.set_high_key(_high_key.clone());
-            return link_siblings(left, right).then([this, midpoint, left, right] {
+            return link_siblings(left, right).then([this, separator{std::move(separator)}, left, right]() mutable {
                 SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Split to {:0>12} + {:0>12}", _id, left.get_id(), right.get_id());
                 _page.set_type(node_type::internal);
-                std::vector<string> keys{_keys[midpoint].clone()};
+                std::vector<string> keys;
+                keys.push_back(std::move(separator));
                 std::vector<node_item_pointer> pointers{node_item_pointer{.child = left.get_id()}, node_item_pointer{.child = right.get_id()}};
                 update_data(std::move(keys), std::move(pointers));
                 return seastar::when_all_succeed(cache(shared_from_this()), cache(left), cache(right)).discard_result();
             });
         });
     }
-    auto separator = _keys[midpoint].clone();
-    update_data(std::move(left_keys), std::move(left_pointers));
-    return create_node(std::move(right_keys), std::move(right_pointers)).then([this, separator{std::move(separator)}](auto sibling) {
+    // The sibling is filled in first, then the keys, the high key and the next link of this node change in a single
+    // step, so that a reader never sees a half-split node and follows the next link for any key it no longer holds
+    return create_node(std::move(right_keys), std::move(right_pointers)).then([this, separator{std::move(separator)}, left_keys{std::move(left_keys)}, left_pointers{std::move(left_pointers)}, path{std::move(path)}](auto sibling) mutable {
         sibling.set_high_key(std::move(_high_key));
+        sibling.set_prev_node(_id);
+        sibling.set_next_node(_next);
+        update_data(std::move(left_keys), std::move(left_pointers));
         _high_key = separator.clone();
-        return link_siblings(shared_from_this(), sibling).then([this, sibling] {
-            return get_parent().then([this, sibling](auto parent) {
-                SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Split to {:0>12}", _page.get_id(), sibling.get_id());
-                sibling.update_parent(parent.get_pointer());
-                return parent.promote(_high_key.clone(), _id, sibling.get_id()).then([this, sibling, parent] {
-                    return seastar::when_all_succeed(cache(parent), cache(shared_from_this()), cache(sibling)).discard_result();
-                });
+        _next = sibling.get_id();
+        return seastar::futurize_invoke([this, sibling] {
+            if (sibling.get_next_node() == null_node) {
+                return seastar::now();
+            }
+            return _btree->get_node(sibling.get_next_node()).then([this, sibling](auto old_next) {
+                old_next.set_prev_node(sibling.get_id());
+                return cache(old_next);
+            });
+        }).then([this, sibling, path{std::move(path)}]() mutable {
+            auto parent = path.back();
+            path.pop_back();
+            SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Split to {:0>12}", _page.get_id(), sibling.get_id());
+            return parent.promote(_high_key.clone(), _id, sibling.get_id(), std::move(path)).then([this, sibling, parent] {
+                return seastar::when_all_succeed(cache(parent), cache(shared_from_this()), cache(sibling)).discard_result();
             });
         });
     });
@@ -439,7 +500,7 @@ bool node_impl::need_split() noexcept {
     return false;
 }
 
-seastar::future<> node_impl::promote(string&& promoted_key, node_id left_child, node_id right_child) {
+seastar::future<> node_impl::promote(string&& promoted_key, node_id left_child, node_id right_child, node_path&& path) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
@@ -453,103 +514,122 @@ seastar::future<> node_impl::promote(string&& promoted_key, node_id left_child,
     _keys.insert(_keys.begin() + id, promoted_key);
     _pointers.insert(_pointers.begin() + id + 1, node_item_pointer{.child = right_child});
     update_metadata();
-    _data_len += promoted_key.length() + sizeof(uint32_t) + sizeof(node_item_pointer);
+    _data_len += promoted_key.length() + slot_size() + sizeof(node_item_pointer);
     SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Promoted key {}", _id, promoted_key);
     if (!need_split()) {
         return seastar::now();
     }
-    return split();
+    return split(std::move(path));
 }
 
-seastar::future<> node_impl::merge() {
+seastar::future<> node_impl::merge(node_path&& path) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
+    // The root has no sibling to merge with
+    if (_id == _btree->get_root().get_id()) {
+        return seastar::now();
+    }
+    assert(!path.empty());
+    auto parent = path.back();
+    path.pop_back();
     auto left_ptr = seastar::make_lw_shared<node>();
     auto right_ptr = seastar::make_lw_shared<node>();
-    return seastar::futurize_invoke([this, left_ptr, right_ptr] {
+    // Writers still inside the sibling finish before it is merged. Only siblings under the same parent are latched,
+    // and that parent is latched by this writer, so they cannot be waiting for this node.
+    auto sibling_latches = seastar::make_lw_shared<latch_list>();
+    return seastar::futurize_invoke([this, parent, left_ptr, right_ptr, sibling_latches] {
         if (_prev == null_node) {
             return seastar::now();
         }
-        return _btree->get_node(_prev).then([this, left_ptr, right_ptr](auto prev) {
-            if (prev.get_parent_node() == _header->_parent && prev.need_merge()) {
-                *left_ptr = prev;
-                *right_ptr = shared_from_this();
+        return _btree->get_node(_prev).then([this, parent, left_ptr, right_ptr, sibling_latches](auto prev) {
+            if (!has_child(parent, prev.get_id())) {
+                return seastar::now();
             }
-            return seastar::now();
+            return seastar::get_units(prev.get_pointer()->_lock, 1).then([this, parent, left_ptr, right_ptr, sibling_latches, prev](auto units) {
+                if (has_child(parent, prev.get_id()) && prev.need_merge()) {
+                    *left_ptr = prev;
+                    *right_ptr = shared_from_this();
+                    sibling_latches->push_back(std::move(units));
+                }
+            });
         });
-    }).then([this, left_ptr, right_ptr] {
+    }).then([this, parent, left_ptr, right_ptr, sibling_latches] {
         if (_next == null_node) {
             return seastar::now();
         }
         if (*left_ptr && *right_ptr) {
             return seastar::now();
         }
-        return _btree->get_node(_next).then([this, left_ptr, right_ptr](auto next) {
-            if (next.get_parent_node() == _header->_parent && next.need_merge()) {
-                *left_ptr = shared_from_this();
-                *right_ptr = next;
+        return _btree->get_node(_next).then([this, parent, left_ptr, right_ptr, sibling_latches](auto next) {
+            if (!has_child(parent, next.get_id())) {
+                return seastar::now();
             }
-            return seastar::now();
+            return seastar::get_units(next.get_pointer()->_lock, 1).then([this, parent, left_ptr, right_ptr, sibling_latches, next](auto units) {
+                if (has_child(parent, next.get_id()) && next.need_merge()) {
+                    *left_ptr = shared_from_this();
+                    *right_ptr = next;
+                    sibling_latches->push_back(std::move(units));
+                }
+            });
         });
-    }).then([this, left_ptr, right_ptr] {
+    }).then([this, parent, left_ptr, right_ptr, path{std::move(path)}]() mutable {
         if (!*left_ptr || !*right_ptr) {
             return seastar::now();
         }
-        return get_parent().then([this, left_ptr, right_ptr](auto parent) {
-            return parent.demote(left_ptr->get_id(), right_ptr->get_id()).then([this, left_ptr, right_ptr](auto&& demoted_key) {
-                // Prepare data
-                std::vector<string> keys;
-                std::vector<node_item_pointer> pointers;
-                const auto& left_keys = left_ptr->get_key_list();
-                const auto& right_keys = right_ptr->get_key_list();
-                const auto& left_pointers = left_ptr->get_pointer_list();
-                const auto& right_pointers = right_ptr->get_pointer_list();
-                const auto& left_high_key = left_ptr->get_high_key();
-                const auto& right_high_key = right_ptr->get_high_key();
-                switch (_page.get_type()) {
-                    case node_type::internal: {
-                        keys.reserve(left_keys.size() + right_keys.size() + 1);
-                        keys.insert(keys.end(), left_keys.begin(), left_keys.end());
-                        keys.push_back(demoted_key);
-                        keys.insert(keys.end(), right_keys.begin(), right_keys.end());
-                        break;
-                    }
-                    case node_type::leaf: {
-                        keys.reserve(left_keys.size() + right_keys.size());
-                        keys.insert(keys.end(), left_keys.begin(), left_keys.end());
-                        keys.insert(keys.end(), right_keys.begin(), right_keys.end());
-                        break;
-                    }
-                    default: {
-                        return seastar::make_exception_future<>(spiderdb_error{error_code::page_type_incorrect});
-                    }
+        return parent.demote(left_ptr->get_id(), right_ptr->get_id(), std::move(path)).then([this, left_ptr, right_ptr](auto&& demoted_key) {
+            // Prepare data
+            std::vector<string> keys;
+            std::vector<node_item_pointer> pointers;
+            const auto& left_keys = left_ptr->get_key_list();
+            const auto& right_keys = right_ptr->get_key_list();
+            const auto& left_pointers = left_ptr->get_pointer_list();
+            const auto& right_pointers = right_ptr->get_pointer_list();
+            const auto& left_high_key = left_ptr->get_high_key();
+            const auto& right_high_key = right_ptr->get_high_key();
+            switch (_page.get_type()) {
+                case node_type::internal: {
+                    keys.reserve(left_keys.size() + right_keys.size() + 1);
+                    keys.insert(keys.end(), left_keys.begin(), left_keys.end());
+                    keys.push_back(demoted_key);
+                    keys.insert(keys.end(), right_keys.begin(), right_keys.end());
+                    break;
                 }
-                pointers.reserve(left_pointers.size() + right_pointers.size());
-                pointers.insert(pointers.end(), left_pointers.begin(), left_pointers.end());
-                pointers.insert(pointers.end(), right_pointers.begin(), right_pointers.end());
-                // Merge
-                left_ptr->update_data(std::move(keys), std::move(pointers));
-                left_ptr->set_high_key(right_high_key.clone());
-                return left_ptr->become_parent().then([this, left_ptr, right_ptr] {
-                    SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Merged {:0>12} to {:0>12}", _id, left_ptr->get_id(), right_ptr->get_id());
-                    if (right_ptr->get_next_node() == null_node) {
-                        left_ptr->set_next_node(null_node);
-                        return seastar::now();
-                    }
-                    return _btree->get_node(right_ptr->get_next_node()).then([this, left_ptr](auto new_right) {
-                        return link_siblings(*left_ptr, new_right).then([this, new_right] {
-                            return cache(new_right);
-                        });
-                    }).then([right_ptr] {
-                        return right_ptr->clean().finally([right_ptr] {});
+                case node_type::leaf: {
+                    keys.reserve(left_keys.size() + right_keys.size());
+                    keys.insert(keys.end(), left_keys.begin(), left_keys.end());
+                    keys.insert(keys.end(), right_keys.begin(), right_keys.end());
+                    break;
+                }
+                default: {
+                    return seastar::make_exception_future<>(spiderdb_error{error_code::page_type_incorrect});
+                }
+            }
+            pointers.reserve(left_pointers.size() + right_pointers.size());
+            pointers.insert(pointers.end(), left_pointers.begin(), left_pointers.end());
+            pointers.insert(pointers.end(), right_pointers.begin(), right_pointers.end());
+            // Merge
+            left_ptr->update_data(std::move(keys), std::move(pointers));
+            left_ptr->set_high_key(right_high_key.clone());
+            return seastar::futurize_invoke([this, left_ptr, right_ptr] {
+                SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Merged {:0>12} to {:0>12}", _id, left_ptr->get_id(), right_ptr->get_id());
+                if (right_ptr->get_next_node() == null_node) {
+                    left_ptr->set_next_node(null_node);
+                    return seastar::now();
+                }
+                return _btree->get_node(right_ptr->get_next_node()).then([this, left_ptr](auto new_right) {
+                    return link_siblings(*left_ptr, new_right).then([this, new_right] {
+                        return cache(new_right);
                     });
                 });
-            }).then([this, parent, left_ptr, right_ptr] {
-                return seastar::when_all_succeed(cache(parent), cache(*left_ptr), cache(*right_ptr)).discard_result();
+            }).then([right_ptr] {
+                // The absorbed node is cleaned whether or not it was the rightmost one
+                return right_ptr->clean().finally([right_ptr] {});
             });
+        }).then([this, parent, left_ptr, right_ptr] {
+            return seastar::when_all_succeed(cache(parent), cache(*left_ptr), cache(*right_ptr)).discard_result();
         });
-    });
+    }).finally([sibling_latches] {});
 }
 
 bool node_impl::need_merge() noexcept {
@@ -566,7 +646,7 @@ bool node_impl::need_merge() noexcept {
     return false;
 }
 
-seastar::future<string> node_impl::demote(node_id left_child, node_id right_child) {
+seastar::future<string> node_impl::demote(node_id left_child, node_id right_child, node_path&& path) {
     if (!is_valid()) {
         return seastar::make_exception_future<string>(spiderdb_error{error_code::node_unavailable});
     }
@@ -586,19 +666,19 @@ seastar::future<string> node_impl::demote(node_id left_child, node_id right_chil
         return seastar::make_exception_future<string>(spiderdb_error{error_code::node_child_not_exists});
     }
     update_metadata();
-    _data_len -= demoted_key.length() + sizeof(uint32_t) + sizeof(node_item_pointer);
+    _data_len -= demoted_key.length() + slot_size() + sizeof(node_item_pointer);
     SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Demoted key {}", _id, demoted_key);
-    return seastar::futurize_invoke([this] {
+    return seastar::futurize_invoke([this, path{std::move(path)}]() mutable {
         if (!need_merge()) {
             return seastar::now();
         }
-        return merge();
+        return merge(std::move(path));
     }).then([demoted_key{std::move(demoted_key)}] {
         return seastar::make_ready_future<string>(demoted_key);
     });
 }
 
-seastar::future<> node_impl::destroy() {
+seastar::future<> node_impl::destroy(node_path&& path) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
@@ -609,10 +689,11 @@ seastar::future<> node_impl::destroy() {
     if (!_keys.empty() || !_pointers.empty()) {
         return seastar::now();
     }
-    return get_parent().then([this](auto parent) {
-        return parent.fire(_id).then([this, parent] {
-            return cache(parent);
-        });
+    assert(!path.empty());
+    auto parent = path.back();
+    path.pop_back();
+    return parent.fire(_id, std::move(path)).then([this, parent] {
+        return cache(parent);
     }).then([this] {
         if (_prev == null_node) {
             return seastar::now();
@@ -640,7 +721,7 @@ bool node_impl::need_destroy() noexcept {
     return _keys.empty() && _pointers.empty();
 }
 
-seastar::future<> node_impl::fire(node_id child) {
+seastar::future<> node_impl::fire(node_id child, node_path&& path) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
@@ -659,10 +740,12 @@ seastar::future<> node_impl::fire(node_id child) {
         _keys.erase(_keys.begin() + id - 1);
     }
     _pointers.erase(_pointers.begin() + id);
+    _heads.clear();
+    ++_version;
     if (!need_destroy()) {
         return seastar::now();
     }
-    return destroy();
+    return destroy(std::move(path));
 }
 
 void node_impl::log() const {
@@ -706,9 +789,7 @@ seastar::future<node> node_impl::create_node(std::vector<string>&& keys, std::ve
     }
     return _btree->create_node(_page.get_type()).then([keys{std::move(keys)}, pointers{std::move(pointers)}](auto child) mutable {
         child.update_data(std::move(keys), std::move(pointers));
-        return child.become_parent().then([child] {
-            return seastar::make_ready_future<node>(child);
-        });
+        return seastar::make_ready_future<node>(child);
     });
 }
 
@@ -738,21 +819,6 @@ seastar::future<> node_impl::cache(node node) {
     return _btree->cache_node(node);
 }
 
-seastar::future<> node_impl::become_parent() {
-    if (!is_valid()) {
-        return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
-    }
-    if (_page.get_type() != node_type::internal) {
-        return seastar::now();
-    }
-    return seastar::parallel_for_each(_pointers, [this](auto pointer) {
-        return _btree->get_node(pointer.child, weak_from_this()).then([this](auto child) {
-             child.update_parent(weak_from_this());
-             return cache(child);
-        });
-    });
-}
-
 void node_impl::update_data(std::vector<string>&& keys, std::vector<node_item_pointer>&& pointers) {
     _keys = std::move(keys);
     _pointers = std::move(pointers);
@@ -765,6 +831,8 @@ void node_impl::update_metadata() {
         throw spiderdb_error{error_code::node_exceeded_max_key_count};
     }
     _header->_key_count = _keys.size();
+    _heads.clear();
+    ++_version;
     if (_keys.size() > 1) {
         auto old_prefix_len = _header->_prefix_len;
         auto calculate_prefix_func = [](string str1, string str2) {
@@ -798,30 +866,133 @@ void node_impl::update_metadata() {
 
 void node_impl::calculate_data_length() noexcept {
     size_t data_len = 0;
-    data_len += _prefix.length();
-    data_len += sizeof(uint32_t) * _keys.size();
+    data_len += slot_size() * _keys.size();
     for (const auto& key : _keys) {
         data_len += key.length() - _prefix.length();
     }
     data_len += _pointers.size() * sizeof(node_item_pointer);
+    data_len += _prefix.length();
     data_len += sizeof(uint32_t) + _high_key.length();
     data_len += sizeof(node_id) * 2;
     _data_len = data_len;
 }
 
+void node_impl::update_heads() {
+    const auto prefix_len = _prefix.length();
+    _heads.clear();
+    _heads.reserve(_keys.size());
+    _fixed_key_len = _keys.empty() ? 0 : _keys.front().length();
+    for (const auto& key : _keys) {
+        _heads.push_back(get_key_head(key.c_str() + prefix_len, key.length() - prefix_len));
+        if (key.length() != _fixed_key_len || key.length() - prefix_len > sizeof(uint64_t)) {
+            _fixed_key_len = 0;
+        }
+    }
+}
+
+void node_impl::encode(char* data) const {
+    // Slot directory, pointer array, prefix, high key and siblings, followed by the key heap
+    auto pos = data;
+    uint32_t heap_offset = slot_size() * _keys.size() + sizeof(node_item_pointer) * _pointers.size() + _prefix.length();
+    heap_offset += sizeof(uint32_t) + _high_key.length() + sizeof(node_id) * 2;
+    for (const auto& key : _keys) {
+        const uint32_t key_len = key.length() - _prefix.length();
+        memcpy(pos, &heap_offset, sizeof(heap_offset));
+        pos += sizeof(heap_offset);
+        memcpy(pos, &key_len, sizeof(key_len));
+        pos += sizeof(key_len);
+        if (key_len > 0) {
+            memcpy(data + heap_offset, key.c_str() + _prefix.length(), key_len);
+        }
+        heap_offset += key_len;
+    }
+    for (const auto& pointer : _pointers) {
+        memcpy(pos, &pointer, sizeof(pointer));
+        pos += sizeof(pointer);
+    }
+    if (_prefix.length() > 0) {
+        memcpy(pos, _prefix.c_str(), _prefix.length());
+        pos += _prefix.length();
+    }
+    const uint32_t high_key_len = _high_key.length();
+    memcpy(pos, &high_key_len, sizeof(high_key_len));
+    pos += sizeof(high_key_len);
+    if (high_key_len > 0) {
+        memcpy(pos, _high_key.c_str(), high_key_len);
+        pos += high_key_len;
+    }
+    memcpy(pos, &_prev, sizeof(_prev));
+    pos += sizeof(_prev);
+    memcpy(pos, &_next, sizeof(_next));
+}
+
+void node_impl::decode(const char* data) {
+    const auto key_count = _header->_key_count;
+    const auto prefix_len = _header->_prefix_len;
+    const auto pointer_count = key_count + (_page.get_type() == node_type::internal ? 1 : 0);
+    auto slot = data;
+    auto pos = data + slot_size() * key_count;
+    // Load pointers
+    _pointers.clear();
+    _pointers.reserve(pointer_count);
+    for (uint32_t i = 0; i < pointer_count; ++i) {
+        node_item_pointer::largest_type current_pointer;
+        memcpy(&current_pointer, pos, sizeof(current_pointer));
+        pos += sizeof(current_pointer);
+        if (_page.get_type() == node_type::internal) {
+            _pointers.push_back(node_item_pointer{.child = node_id{static_cast<node_id::underlying_type>(current_pointer)}});
+        } else {
+            _pointers.push_back(node_item_pointer{.pointer = value_pointer{static_cast<value_pointer::underlying_type>(current_pointer)}});
+        }
+    }
+    // Load prefix
+    _prefix = (prefix_len > 0) ? string{pos, prefix_len} : string{};
+    pos += prefix_len;
+    // Load high key
+    uint32_t high_key_len;
+    memcpy(&high_key_len, pos, sizeof(high_key_len));
+    pos += sizeof(high_key_len);
+    _high_key = (high_key_len > 0) ? string{pos, high_key_len} : string{};
+    pos += high_key_len;
+    // Load siblings
+    memcpy(&_prev, pos, sizeof(_prev));
+    pos += sizeof(_prev);
+    memcpy(&_next, pos, sizeof(_next));
+    // Load keys, each one copied once from the key heap
+    _heads.clear();
+    _keys.clear();
+    _keys.reserve(key_count);
+    for (uint32_t i = 0; i < key_count; ++i) {
+        uint32_t key_offset;
+        memcpy(&key_offset, slot, sizeof(key_offset));
+        slot += sizeof(key_offset);
+        uint32_t key_len;
+        memcpy(&key_len, slot, sizeof(key_len));
+        slot += sizeof(key_len);
+        string key{static_cast<size_t>(prefix_len + key_len), 0};
+        if (prefix_len > 0) {
+            memcpy(key.str(), _prefix.c_str(), prefix_len);
+        }
+        if (key_len > 0) {
+            memcpy(key.str() + prefix_len, data + key_offset, key_len);
+        }
+        _keys.push_back(std::move(key));
+    }
+}
+
 seastar::future<> node_impl::clean() {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
     _page.set_type(node_type::unused);
+    _cleaned = true;
     update_data({}, {});
-    _parent = nullptr;
+    _children.clear();
     _next = null_node;
     _prev = null_node;
     _prefix = string{};
     _high_key = string{};
     _data_len = 0;
-    _header->_parent = null_node;
     _header->_key_count = 0;
     _header->_prefix_len = 0;
     SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Cleaned", _id);
@@ -832,8 +1003,8 @@ bool node_impl::is_valid() const noexcept {
     return (bool)_btree && (bool)_header;
 }
 
-node::node(page page, seastar::weak_ptr<btree_impl>&& btree, seastar::weak_ptr<node_impl>&& parent) {
-    _impl = seastar::make_lw_shared<node_impl>(std::move(page), std::move(btree), std::move(parent));
+node::node(page page, seastar::weak_ptr<btree_impl>&& btree) {
+    _impl = seastar::make_lw_shared<node_impl>(std::move(page), std::move(btree));
 }
 
 node::node(seastar::lw_shared_ptr<node_impl> impl) {
@@ -901,13 +1072,6 @@ const std::vector<node_item_pointer>& node::get_pointer_list() const {
     return _impl->_pointers;
 }
 
-node_id node::get_parent_node() const {
-    if (!_impl) {
-        throw spiderdb_error{error_code::node_unavailable};
-    }
-    return _impl->_header->_parent;
-}
-
 node_id node::get_next_node() const {
     if (!_impl) {
         throw spiderdb_error{error_code::node_unavailable};
@@ -934,6 +1098,7 @@ void node::set_next_node(node_id next) const {
         throw spiderdb_error{error_code::node_unavailable};
     }
     _impl->_next = next;
+    ++_impl->_version;
     _impl->_dirty = true;
 }
 
@@ -942,6 +1107,7 @@ void node::set_prev_node(node_id prev) const {
         throw spiderdb_error{error_code::node_unavailable};
     }
     _impl->_prev = prev;
+    ++_impl->_version;
     _impl->_dirty = true;
 }
 
@@ -950,6 +1116,7 @@ void node::set_high_key(string&& high_key) const {
         throw spiderdb_error{error_code::node_unavailable};
     }
     _impl->_high_key = std::move(high_key);
+    ++_impl->_version;
     _impl->_dirty = true;
 }
 
@@ -995,13 +1162,6 @@ seastar::future<value_pointer> node::find(string&& key) const {
     return _impl->find(std::move(key));
 }
 
-void node::update_parent(seastar::weak_ptr<node_impl>&& parent) const {
-    if (!_impl) {
-        throw spiderdb_error{error_code::node_unavailable};
-    }
-    _impl->update_parent(std::move(parent));
-}
-
 int64_t node::binary_search(const string& key, int64_t low, int64_t high) const {
     if (!_impl) {
         throw spiderdb_error{error_code::node_unavailable};
@@ -1009,11 +1169,11 @@ int64_t node::binary_search(const string& key, int64_t low, int64_t high) const
     return _impl->binary_search(key, low, high);
 }
 
-seastar::future<> node::split() const {
+seastar::future<> node::split(node_path&& path) const {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
-    return _impl->split();
+    return _impl->split(std::move(path));
 }
 
 bool node::need_split() const {
@@ -1023,18 +1183,18 @@ bool node::need_split() const {
     return _impl->need_split();
 }
 
-seastar::future<> node::promote(string&& key, node_id left_child, node_id right_child) const {
+seastar::future<> node::promote(string&& key, node_id left_child, node_id right_child, node_path&& path) const {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
-    return _impl->promote(std::move(key), left_child, right_child);
+    return _impl->promote(std::move(key), left_child, right_child, std::move(path));
 }
 
-seastar::future<> node::merge() const {
+seastar::future<> node::merge(node_path&& path) const {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
-    return _impl->merge();
+    return _impl->merge(std::move(path));
 }
 
 bool node::need_merge() const {
@@ -1044,18 +1204,18 @@ bool node::need_merge() const {
     return _impl->need_merge();
 }
 
-seastar::future<string> node::demote(node_id left_child, node_id right_child) const {
+seastar::future<string> node::demote(node_id left_child, node_id right_child, node_path&& path) const {
     if (!_impl) {
         return seastar::make_exception_future<string>(spiderdb_error{error_code::node_unavailable});
     }
-    return _impl->demote(left_child, right_child);
+    return _impl->demote(left_child, right_child, std::move(path));
 }
 
-seastar::future<> node::destroy() const {
+seastar::future<> node::destroy(node_path&& path) const {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
-    return _impl->destroy();
+    return _impl->destroy(std::move(path));
 }
 
 bool node::need_destroy() const {
@@ -1065,18 +1225,11 @@ bool node::need_destroy() const {
     return _impl->need_destroy();
 }
 
-seastar::future<> node::fire(node_id child) const {
-    if (!_impl) {
-        return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
-    }
-    return _impl->fire(child);
-}
-
-seastar::future<> node::become_parent() const {
+seastar::future<> node::fire(node_id child, node_path&& path) const {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::node_unavailable});
     }
-    return _impl->become_parent();
+    return _impl->fire(child, std::move(path));
 }
 
 void node::update_data(std::vector<string>&& keys, std::vector<node_item_pointer>&& pointers) const {
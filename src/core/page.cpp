@@ -17,6 +17,8 @@ seastar::future<> page_header::write(seastar::temporary_buffer<char> buffer) {
     buffer.trim_front(sizeof(_record_len));
     memcpy(&_next, buffer.begin(), sizeof(_next));
     buffer.trim_front(sizeof(_next));
+    memcpy(&_lsn, buffer.begin(), sizeof(_lsn));
+    buffer.trim_front(sizeof(_lsn));
     return seastar::now();
 }
 
@@ -29,6 +31,8 @@ seastar::future<> page_header::read(seastar::temporary_buffer<char> buffer) {
     buffer.trim_front(sizeof(_record_len));
     memcpy(buffer.get_write(), &_next, sizeof(_next));
     buffer.trim_front(sizeof(_next));
+    memcpy(buffer.get_write(), &_lsn, sizeof(_lsn));
+    buffer.trim_front(sizeof(_lsn));
     return seastar::now();
 }
 
@@ -37,14 +41,87 @@ void page_header::log() const noexcept {
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Data length: ", _data_len);
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Record length: ", _record_len);
     SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Next page: ", _next);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "LSN: ", _lsn);
 }
 
-page_impl::page_impl(page_id id, const spiderdb_config& config) : _id{id}, _config{config} {
-    _data = string{_config.page_size, 0};
+page_frame_arena::page_frame_arena(const spiderdb_config& config) : _config{config} {}
+
+seastar::temporary_buffer<char> page_frame_arena::allocate(uint32_t size) {
+    auto& free_frames = _free_frames[size];
+    if (free_frames.empty()) {
+        auto frame = seastar::temporary_buffer<char>::aligned(_config.page_frame_alignment, size);
+        memset(frame.get_write(), 0, frame.size());
+        _resident_bytes += frame.size();
+        return frame;
+    }
+    auto frame = std::move(free_frames.back());
+    free_frames.pop_back();
+    memset(frame.get_write(), 0, frame.size());
+    return frame;
+}
+
+void page_frame_arena::release(seastar::temporary_buffer<char>&& frame) {
+    if (frame.empty()) {
+        return;
+    }
+    auto& free_frames = _free_frames[frame.size()];
+    if (free_frames.size() < _config.n_free_page_frames) {
+        free_frames.push_back(std::move(frame));
+    } else {
+        _resident_bytes -= frame.size();
+    }
+}
+
+uint64_t page_frame_arena::trim() noexcept {
+    uint64_t released_bytes = 0;
+    for (auto& free_frames : _free_frames) {
+        for (const auto& frame : free_frames.second) {
+            released_bytes += frame.size();
+        }
+        free_frames.second.clear();
+    }
+    _resident_bytes -= released_bytes;
+    return released_bytes;
+}
+
+size_t page_frame_arena::size() const noexcept {
+    size_t size = 0;
+    for (const auto& free_frames : _free_frames) {
+        size += free_frames.second.size();
+    }
+    return size;
+}
+
+uint64_t page_frame_arena::get_resident_bytes() const noexcept {
+    return _resident_bytes;
+}
+
+page_impl::page_impl(page_id id, uint32_t size, const spiderdb_config& config, seastar::weak_ptr<page_frame_arena>&& arena)
+        : _id{id}, _size{size}, _config{config}, _arena{std::move(arena)} {
+    if (_arena) {
+        _data = _arena->allocate(_size);
+    } else {
+        _data = seastar::temporary_buffer<char>::aligned(_config.page_frame_alignment, _size);
+        memset(_data.get_write(), 0, _data.size());
+    }
+}
+
+page_impl::~page_impl() {
+    if (_arena) {
+        _arena->release(std::move(_data));
+    }
+}
+
+uint32_t page_impl::get_size() const noexcept {
+    return _size;
 }
 
 uint32_t page_impl::get_work_size() const noexcept {
-    return _config.page_size - _config.page_header_size;
+    return _size - _config.page_header_size;
+}
+
+uint64_t page_impl::get_offset() const noexcept {
+    return _config.file_header_size + _id.get() * _config.page_size;
 }
 
 seastar::future<> page_impl::load(seastar::file file) {
@@ -55,27 +132,25 @@ seastar::future<> page_impl::load(seastar::file file) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
     }
     return seastar::with_semaphore(_lock, 1, [this, file]() mutable {
-        const auto page_offset = _config.file_header_size + _id.get() * _config.page_size;
-        return file.dma_read_exactly<char>(page_offset, _config.page_size).then([this](auto buffer) {
-            memcpy(_data.str(), buffer.get(), buffer.size());
-            return _header->write(std::move(buffer));
-        }).then([this] {
-            if (_header->_type == page_type::internal || _header->_type == page_type::leaf) {
-                SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Loaded", _id);
-            } else {
-                SPIDERDB_LOGGER_DEBUG("Page {:0>12} - Loaded", _id);
+        // Read straight into the aligned page frame
+        return file.dma_read(get_offset(), _data.get_write(), _data.size()).then([this](auto read_size) {
+            if (read_size < _data.size()) {
+                // Page has never been flushed
+                return seastar::now();
             }
-            _header->log();
-        }).handle_exception([this](auto ex) {
-            try {
-                std::rethrow_exception(ex);
-            } catch (seastar::file::eof_error& err) {
-            } catch (...) {
+            return _header->write(_data.share()).then([this] {
                 if (_header->_type == page_type::internal || _header->_type == page_type::leaf) {
-                    SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Failed to load", _id);
+                    SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Loaded", _id);
                 } else {
-                    SPIDERDB_LOGGER_DEBUG("Page {:0>12} - Failed to load", _id);
+                    SPIDERDB_LOGGER_DEBUG("Page {:0>12} - Loaded", _id);
                 }
+                _header->log();
+            });
+        }).handle_exception([this](auto ex) {
+            if (_header->_type == page_type::internal || _header->_type == page_type::leaf) {
+                SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Failed to load", _id);
+            } else {
+                SPIDERDB_LOGGER_DEBUG("Page {:0>12} - Failed to load", _id);
             }
         });
     });
@@ -89,11 +164,8 @@ seastar::future<> page_impl::flush(seastar::file file) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
     }
     return seastar::with_semaphore(_lock, 1, [this, file]() mutable {
-        seastar::temporary_buffer<char> buffer{_data.str(), _data.size()};
-        memset(buffer.get_write(), 0, _config.page_header_size);
-        return _header->read(buffer.share()).then([this, file, buffer{buffer.share()}]() mutable {
-            const auto page_offset = _config.file_header_size + _id.get() * _config.page_size;
-            return file.dma_write(page_offset, buffer.get_write(), buffer.size()).then([buffer{buffer.share()}](auto) {});
+        return snapshot().then([this, file](auto buffer) mutable {
+            return file.dma_write(get_offset(), buffer.get(), buffer.size()).then([buffer{std::move(buffer)}](auto) {});
         }).then([this] {
             if (_header->_type == page_type::internal || _header->_type == page_type::leaf) {
                 SPIDERDB_LOGGER_DEBUG("Node {:0>12} - Flushed", _id);
@@ -111,6 +183,28 @@ seastar::future<> page_impl::flush(seastar::file file) {
     });
 }
 
+seastar::future<> page_impl::seal() {
+    if (!is_valid()) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    memset(_data.get_write(), 0, _config.page_header_size);
+    return _header->read(_data.share());
+}
+
+seastar::future<seastar::temporary_buffer<char>> page_impl::snapshot() {
+    if (!is_valid()) {
+        return seastar::make_exception_future<seastar::temporary_buffer<char>>(spiderdb_error{error_code::page_unavailable});
+    }
+    // Copied under the read lock, since writes keep going on the frame while the copy is on its way to the disk
+    return seastar::with_lock(_rwlock.for_read(), [this] {
+        return seal().then([this] {
+            auto frame = seastar::temporary_buffer<char>::aligned(_config.page_frame_alignment, _size);
+            memcpy(frame.get_write(), _data.get(), _size);
+            return frame;
+        });
+    });
+}
+
 seastar::future<> page_impl::write(seastar::simple_memory_input_stream& is) {
     if (!is_valid()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
@@ -118,7 +212,24 @@ seastar::future<> page_impl::write(seastar::simple_memory_input_stream& is) {
     return seastar::with_lock(_rwlock.for_write(), [this, &is] {
         _header->_data_len = std::min(get_work_size(), static_cast<uint32_t>(is.size()));
         if (_header->_data_len > 0) {
-            is.read(_data.str() + _config.page_header_size, _header->_data_len);
+            is.read(_data.get_write() + _config.page_header_size, _header->_data_len);
+        }
+        return seastar::now();
+    });
+}
+
+seastar::future<> page_impl::write(uint32_t len, std::function<void(char*)> encode) {
+    if (!is_valid()) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    if (len > get_work_size()) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    return seastar::with_lock(_rwlock.for_write(), [this, len, encode{std::move(encode)}] {
+        // Encoded straight into the page frame
+        _header->_data_len = len;
+        if (len > 0) {
+            encode(_data.get_write() + _config.page_header_size);
         }
         return seastar::now();
     });
@@ -130,7 +241,7 @@ seastar::future<> page_impl::read(seastar::simple_memory_output_stream& os) {
     }
     return seastar::with_lock(_rwlock.for_read(), [this, &os] {
         if (_header->_data_len > 0) {
-            os.write(_data.str() + _config.page_header_size, _header->_data_len);
+            os.write(_data.get() + _config.page_header_size, _header->_data_len);
         }
         return seastar::now();
     });
@@ -144,8 +255,8 @@ bool page_impl::is_valid() const noexcept {
     return (bool)_header;
 }
 
-page::page(page_id id, const spiderdb_config& config) {
-    _impl = seastar::make_lw_shared<page_impl>(id, config);
+page::page(page_id id, uint32_t size, const spiderdb_config& config, seastar::weak_ptr<page_frame_arena>&& arena) {
+    _impl = seastar::make_lw_shared<page_impl>(id, size, config, std::move(arena));
 }
 
 page::page(seastar::lw_shared_ptr<page_impl> impl) {
@@ -191,6 +302,13 @@ seastar::shared_ptr<page_header> page::get_header() const {
     return _impl->_header;
 }
 
+uint32_t page::get_size() const {
+    if (!_impl) {
+        throw spiderdb_error{error_code::page_unavailable};
+    }
+    return _impl->get_size();
+}
+
 uint32_t page::get_work_size() const {
     if (!_impl) {
         throw spiderdb_error{error_code::page_unavailable};
@@ -198,6 +316,20 @@ uint32_t page::get_work_size() const {
     return _impl->get_work_size();
 }
 
+uint64_t page::get_offset() const {
+    if (!_impl) {
+        throw spiderdb_error{error_code::page_unavailable};
+    }
+    return _impl->get_offset();
+}
+
+seastar::temporary_buffer<char> page::get_frame() const {
+    if (!_impl) {
+        throw spiderdb_error{error_code::page_unavailable};
+    }
+    return _impl->_data.share();
+}
+
 uint32_t page::get_record_length() const {
     if (!_impl) {
         throw spiderdb_error{error_code::page_unavailable};
@@ -219,6 +351,13 @@ page_type page::get_type() const {
     return _impl->_header->_type;
 }
 
+uint64_t page::get_lsn() const {
+    if (!_impl) {
+        throw spiderdb_error{error_code::page_unavailable};
+    }
+    return _impl->_header->_lsn;
+}
+
 void page::set_header(seastar::shared_ptr<page_header> header) {
     if (!_impl) {
         throw spiderdb_error{error_code::page_unavailable};
@@ -240,6 +379,13 @@ void page::set_next_page(page_id next) {
     _impl->_header->_next = next;
 }
 
+void page::set_lsn(uint64_t lsn) {
+    if (!_impl) {
+        throw spiderdb_error{error_code::page_unavailable};
+    }
+    _impl->_header->_lsn = lsn;
+}
+
 void page::set_type(page_type type) {
     if (!_impl) {
         throw spiderdb_error{error_code::page_unavailable};
@@ -261,6 +407,20 @@ seastar::future<> page::flush(seastar::file file) {
     return _impl->flush(std::move(file));
 }
 
+seastar::future<> page::seal() {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    return _impl->seal();
+}
+
+seastar::future<seastar::temporary_buffer<char>> page::snapshot() {
+    if (!_impl) {
+        return seastar::make_exception_future<seastar::temporary_buffer<char>>(spiderdb_error{error_code::page_unavailable});
+    }
+    return _impl->snapshot();
+}
+
 seastar::future<> page::write(seastar::simple_memory_input_stream& is) {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
@@ -268,6 +428,13 @@ seastar::future<> page::write(seastar::simple_memory_input_stream& is) {
     return _impl->write(is);
 }
 
+seastar::future<> page::write(uint32_t len, std::function<void(char*)> encode) {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
+    }
+    return _impl->write(len, std::move(encode));
+}
+
 seastar::future<> page::read(seastar::simple_memory_output_stream& os) {
     if (!_impl) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::page_unavailable});
@@ -4,16 +4,64 @@
 
 #include <spiderdb/core/spiderdb.h>
 #include <spiderdb/util/hasher.h>
+#include <spiderdb/util/log.h>
+#include <seastar/core/seastar.hh>
+#include <seastar/core/sharded.hh>
 
 namespace spiderdb {
 
+seastar::future<> manifest::flush(seastar::file file) {
+    if (!file) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    auto buffer = seastar::temporary_buffer<char>::aligned(file.memory_dma_alignment(), _size);
+    return seastar::do_with(std::move(buffer), [this, file](auto& buffer) mutable {
+        return read(buffer.share()).then([file, buffer{buffer.share()}]() mutable {
+            return file.dma_write(0, buffer.begin(), buffer.size()).then([file](auto) mutable {
+                return file.flush();
+            });
+        });
+    });
+}
+
+seastar::future<> manifest::load(seastar::file file) {
+    if (!file) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return file.dma_read_exactly<char>(0, _size).then([this](auto buffer) {
+        return write(buffer.share());
+    });
+}
+
+seastar::future<> manifest::write(seastar::temporary_buffer<char> buffer) {
+    memcpy(&_shard_count, buffer.begin(), sizeof(_shard_count));
+    buffer.trim_front(sizeof(_shard_count));
+    memcpy(&_hasher_id, buffer.begin(), sizeof(_hasher_id));
+    buffer.trim_front(sizeof(_hasher_id));
+    return seastar::now();
+}
+
+seastar::future<> manifest::read(seastar::temporary_buffer<char> buffer) {
+    memset(buffer.get_write(), 0, _size);
+    memcpy(buffer.get_write(), &_shard_count, sizeof(_shard_count));
+    buffer.trim_front(sizeof(_shard_count));
+    memcpy(buffer.get_write(), &_hasher_id, sizeof(_hasher_id));
+    buffer.trim_front(sizeof(_hasher_id));
+    return seastar::now();
+}
+
 spiderdb_impl::spiderdb_impl(std::string name, spiderdb_config config) : _name{name}, _config{config} {}
 
 seastar::future<> spiderdb_impl::open() {
     if (is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::file_already_opened});
     }
-    return _storage.start(_name, _config).then([this] {
+    return open_manifest().then([this] {
+        // Each shard owns its own file, so one shard's I/O never touches another shard's pages
+        return _storage.start(seastar::sharded_parameter([this] {
+            return get_shard_name(seastar::this_shard_id());
+        }), _config);
+    }).then([this] {
         return _storage.invoke_on_all([](auto& storage) {
             return storage.open();
         });
@@ -29,32 +77,35 @@ seastar::future<> spiderdb_impl::flush() {
 seastar::future<> spiderdb_impl::close() {
     return _storage.invoke_on_all([](auto& storage) {
         return storage.close();
+    }).finally([this] {
+        // Lets the database be opened again
+        return _storage.stop();
     });
 }
 
-seastar::future<> spiderdb_impl::insert(string&& key, string&& value) {
-    auto shard = hasher((string_view)key) % seastar::smp::count;
-    return _storage.invoke_on(shard, [key{std::move(key)}, value{std::move(value)}](auto& storage) mutable {
-        return storage.insert(std::move(key), std::move(value));
+seastar::future<> spiderdb_impl::insert(string&& key, string&& value, durability level) {
+    auto shard = get_shard(key);
+    return _storage.invoke_on(shard, [key{std::move(key)}, value{std::move(value)}, level](auto& storage) mutable {
+        return storage.insert(std::move(key), std::move(value), level);
     });
 }
 
-seastar::future<> spiderdb_impl::update(string&& key, string&& value) {
-    auto shard = hasher((string_view)key) % seastar::smp::count;
-    return _storage.invoke_on(shard, [key{std::move(key)}, value{std::move(value)}](auto& storage) mutable {
-        return storage.update(std::move(key), std::move(value));
+seastar::future<> spiderdb_impl::update(string&& key, string&& value, durability level) {
+    auto shard = get_shard(key);
+    return _storage.invoke_on(shard, [key{std::move(key)}, value{std::move(value)}, level](auto& storage) mutable {
+        return storage.update(std::move(key), std::move(value), level);
     });
 }
 
-seastar::future<> spiderdb_impl::erase(string&& key) {
-    auto shard = hasher((string_view)key) % seastar::smp::count;
-    return _storage.invoke_on(shard, [key{std::move(key)}](auto& storage) mutable {
-        return storage.erase(std::move(key));
+seastar::future<> spiderdb_impl::erase(string&& key, durability level) {
+    auto shard = get_shard(key);
+    return _storage.invoke_on(shard, [key{std::move(key)}, level](auto& storage) mutable {
+        return storage.erase(std::move(key), level);
     });
 }
 
 seastar::future<string> spiderdb_impl::select(string&& key) {
-    auto shard = hasher((string_view)key) % seastar::smp::count;
+    auto shard = get_shard(key);
     return _storage.invoke_on(shard, [key{std::move(key)}](auto& storage) mutable {
         return storage.select(std::move(key));
     });
@@ -64,6 +115,67 @@ bool spiderdb_impl::is_open() const noexcept {
     return _storage.local_is_initialized();
 }
 
+seastar::future<> spiderdb_impl::open_manifest() {
+    auto manifest_name = get_manifest_name();
+    return seastar::file_exists(manifest_name).then([this](auto exists) {
+        if (exists) {
+            return seastar::make_ready_future<bool>(exists);
+        }
+        // Shards are numbered from 0, so any database opened before has the first shard file, and one from before
+        // sharding has a single file under its name. A new manifest would route their keys by this run's shard count.
+        return seastar::file_exists(_name).then([this](auto unsharded) {
+            return seastar::file_exists(get_shard_name(0)).then([this, unsharded](auto sharded) {
+                if (unsharded || sharded) {
+                    return seastar::make_exception_future<bool>(spiderdb_error{error_code::manifest_mismatch, fmt::format(
+                            "found the data of {} without its manifest", _name
+                    )});
+                }
+                return seastar::make_ready_future<bool>(false);
+            });
+        });
+    }).then([this, manifest_name](auto exists) {
+        return seastar::open_file_dma(manifest_name, seastar::open_flags::create | seastar::open_flags::rw).then([this, exists](auto file) {
+            _manifest._size = _config.file_header_size;
+            return seastar::futurize_invoke([this, file, exists]() mutable {
+                if (!exists) {
+                    _manifest._shard_count = seastar::smp::count;
+                    _manifest._hasher_id = hasher_id;
+                    SPIDERDB_LOGGER_INFO("Created manifest: {} ({} shards)", _name, _manifest._shard_count);
+                    return _manifest.flush(file);
+                }
+                return _manifest.load(file).then([this] {
+                    if (_manifest._shard_count != seastar::smp::count) {
+                        return seastar::make_exception_future<>(spiderdb_error{error_code::manifest_mismatch, fmt::format(
+                                "created with {} shards, opened with {}", _manifest._shard_count, seastar::smp::count
+                        )});
+                    }
+                    if (_manifest._hasher_id != hasher_id) {
+                        return seastar::make_exception_future<>(spiderdb_error{error_code::manifest_mismatch, fmt::format(
+                                "created with hasher {}, opened with {}", _manifest._hasher_id, hasher_id
+                        )});
+                    }
+                    SPIDERDB_LOGGER_INFO("Opened manifest: {} ({} shards)", _name, _manifest._shard_count);
+                    return seastar::now();
+                });
+            }).finally([file]() mutable {
+                return file.close().finally([file] {});
+            });
+        });
+    });
+}
+
+std::string spiderdb_impl::get_manifest_name() const {
+    return _name + ".manifest";
+}
+
+std::string spiderdb_impl::get_shard_name(unsigned shard) const {
+    return _name + ".shard-" + std::to_string(shard);
+}
+
+unsigned spiderdb_impl::get_shard(const string& key) const {
+    return hasher((string_view)key) % seastar::smp::count;
+}
+
 spiderdb::spiderdb(std::string name, spiderdb_config config) {
     _impl = seastar::make_lw_shared<spiderdb_impl>(std::move(name), config);
 }
@@ -108,24 +220,45 @@ seastar::future<> spiderdb::close() const {
 }
 
 seastar::future<> spiderdb::insert(string&& key, string&& value) const {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return insert(std::move(key), std::move(value), _impl->_config.default_durability);
+}
+
+seastar::future<> spiderdb::insert(string&& key, string&& value, durability level) const {
     if (!_impl || !_impl->is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
-    return _impl->insert(std::move(key), std::move(value));
+    return _impl->insert(std::move(key), std::move(value), level);
 }
 
 seastar::future<> spiderdb::update(string&& key, string&& value) const {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return update(std::move(key), std::move(value), _impl->_config.default_durability);
+}
+
+seastar::future<> spiderdb::update(string&& key, string&& value, durability level) const {
     if (!_impl || !_impl->is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
-    return _impl->update(std::move(key), std::move(value));
+    return _impl->update(std::move(key), std::move(value), level);
 }
 
 seastar::future<> spiderdb::erase(string&& key) const {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return erase(std::move(key), _impl->_config.default_durability);
+}
+
+seastar::future<> spiderdb::erase(string&& key, durability level) const {
     if (!_impl || !_impl->is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
-    return _impl->erase(std::move(key));
+    return _impl->erase(std::move(key), level);
 }
 
 seastar::future<string> spiderdb::select(string&& key) const {
@@ -4,9 +4,25 @@
 
 #include <spiderdb/core/storage.h>
 #include <spiderdb/util/log.h>
+#include <algorithm>
+#include <unordered_set>
 
 namespace spiderdb {
 
+namespace {
+
+bool has_error_code(std::exception_ptr ex, error_code code) {
+    try {
+        std::rethrow_exception(ex);
+    } catch (const spiderdb_error& err) {
+        return err.get_error_code() == code;
+    } catch (...) {
+        return false;
+    }
+}
+
+}
+
 available_page_list::available_page_list(size_t capacity) : _capacity{capacity} {}
 
 void available_page_list::set_min_available_space(uint32_t min_available_space) {
@@ -82,47 +98,281 @@ size_t available_page_list::size() const noexcept {
     return sizeof(size) + size * (sizeof(page_id) + sizeof(uint32_t));
 }
 
+value_cache::value_cache(uint64_t capacity, uint32_t max_value_size) : _capacity{capacity}, _max_value_size{max_value_size} {}
+
+std::optional<string> value_cache::get(const string& key) {
+    auto index_it = _index.find(get_view(key));
+    if (index_it == _index.end()) {
+        return std::nullopt;
+    }
+    _entries.splice(_entries.begin(), _entries, index_it->second);
+    return index_it->second->second;
+}
+
+void value_cache::put(const string& key, const string& value) {
+    erase(key);
+    const auto entry_size = get_entry_size(key, value);
+    if (value.length() > _max_value_size || entry_size > _capacity) {
+        return;
+    }
+    while (!_entries.empty() && _size + entry_size > _capacity) {
+        auto& victim = _entries.back();
+        _size -= get_entry_size(victim.first, victim.second);
+        _index.erase(get_view(victim.first));
+        _entries.pop_back();
+    }
+    // The index refers to the key owned by the entry
+    _entries.emplace_front(key, value);
+    _index.emplace(get_view(_entries.front().first), _entries.begin());
+    _size += entry_size;
+}
+
+bool value_cache::contains(const string& key) const {
+    return _index.find(get_view(key)) != _index.end();
+}
+
+void value_cache::erase(const string& key) {
+    auto index_it = _index.find(get_view(key));
+    if (index_it == _index.end()) {
+        return;
+    }
+    auto entry_it = index_it->second;
+    _index.erase(index_it);
+    _size -= get_entry_size(entry_it->first, entry_it->second);
+    _entries.erase(entry_it);
+}
+
+void value_cache::clear() noexcept {
+    _index.clear();
+    _entries.clear();
+    _size = 0;
+}
+
+uint64_t value_cache::get_size() const noexcept {
+    return _size;
+}
+
+size_t value_cache::get_count() const noexcept {
+    return _entries.size();
+}
+
+std::string_view value_cache::get_view(const string& key) noexcept {
+    return std::string_view{key.c_str(), key.length()};
+}
+
+uint64_t value_cache::get_entry_size(const string& key, const string& value) noexcept {
+    // Includes a rough overhead for the list node and the index entry
+    return key.length() + value.length() + (1 << 6);
+}
+
+bloom_filter::bloom_filter(uint64_t capacity, uint32_t bits_per_key) : _capacity{capacity} {
+    const uint64_t n_bits = std::max<uint64_t>(capacity * bits_per_key, 64);
+    _bits.resize((n_bits + 63) / 64, 0);
+    // About ln(2) hashes per bit minimizes the false positive rate
+    _n_hashes = std::clamp<uint32_t>(bits_per_key * 69 / 100, 1, 30);
+}
+
+uint64_t bloom_filter::get_hash(const string& key) noexcept {
+    // FNV-1a, which stays stable across restarts
+    uint64_t res = 14695981039346656037ull;
+    for (size_t i = 0; i < key.length(); ++i) {
+        res ^= static_cast<unsigned char>(key.c_str()[i]);
+        res *= 1099511628211ull;
+    }
+    return res;
+}
+
+void bloom_filter::add(uint64_t hash) noexcept {
+    const uint64_t n_bits = _bits.size() * 64;
+    const uint64_t delta = (hash >> 32) | (hash << 32) | 1;
+    for (uint32_t i = 0; i < _n_hashes; ++i) {
+        const auto bit = hash % n_bits;
+        _bits[bit / 64] |= uint64_t{1} << (bit % 64);
+        hash += delta;
+    }
+    ++_n_keys;
+}
+
+bool bloom_filter::may_contain(uint64_t hash) const noexcept {
+    const uint64_t n_bits = _bits.size() * 64;
+    const uint64_t delta = (hash >> 32) | (hash << 32) | 1;
+    for (uint32_t i = 0; i < _n_hashes; ++i) {
+        const auto bit = hash % n_bits;
+        if ((_bits[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) {
+            return false;
+        }
+        hash += delta;
+    }
+    return true;
+}
+
+void bloom_filter::mark_erased() noexcept {
+    ++_n_erased;
+}
+
+bool bloom_filter::need_rebuild() const noexcept {
+    // Erased keys cannot be cleared from the bits, so they only go away on rebuild
+    return _n_keys > _capacity || _n_erased > _n_keys / 2;
+}
+
+seastar::future<> bloom_filter::write(seastar::temporary_buffer<char> buffer) {
+    memcpy(&_capacity, buffer.begin(), sizeof(_capacity));
+    buffer.trim_front(sizeof(_capacity));
+    memcpy(&_n_hashes, buffer.begin(), sizeof(_n_hashes));
+    buffer.trim_front(sizeof(_n_hashes));
+    memcpy(&_n_keys, buffer.begin(), sizeof(_n_keys));
+    buffer.trim_front(sizeof(_n_keys));
+    memcpy(&_n_erased, buffer.begin(), sizeof(_n_erased));
+    buffer.trim_front(sizeof(_n_erased));
+    uint64_t n_words;
+    memcpy(&n_words, buffer.begin(), sizeof(n_words));
+    buffer.trim_front(sizeof(n_words));
+    if (buffer.size() < n_words * sizeof(uint64_t)) {
+        // Left empty, so that the filter gets rebuilt
+        return seastar::now();
+    }
+    _bits.resize(n_words);
+    memcpy(_bits.data(), buffer.begin(), n_words * sizeof(uint64_t));
+    return seastar::now();
+}
+
+seastar::future<> bloom_filter::read(seastar::temporary_buffer<char> buffer) {
+    memcpy(buffer.get_write(), &_capacity, sizeof(_capacity));
+    buffer.trim_front(sizeof(_capacity));
+    memcpy(buffer.get_write(), &_n_hashes, sizeof(_n_hashes));
+    buffer.trim_front(sizeof(_n_hashes));
+    memcpy(buffer.get_write(), &_n_keys, sizeof(_n_keys));
+    buffer.trim_front(sizeof(_n_keys));
+    memcpy(buffer.get_write(), &_n_erased, sizeof(_n_erased));
+    buffer.trim_front(sizeof(_n_erased));
+    uint64_t n_words = _bits.size();
+    memcpy(buffer.get_write(), &n_words, sizeof(n_words));
+    buffer.trim_front(sizeof(n_words));
+    memcpy(buffer.get_write(), _bits.data(), n_words * sizeof(uint64_t));
+    return seastar::now();
+}
+
+size_t bloom_filter::size() const noexcept {
+    return sizeof(_capacity) + sizeof(_n_hashes) + sizeof(_n_keys) + sizeof(_n_erased) + sizeof(uint64_t) + _bits.size() * sizeof(uint64_t);
+}
+
+bool bloom_filter::empty() const noexcept {
+    return _bits.empty();
+}
+
+uint64_t bloom_filter::get_key_count() const noexcept {
+    return _n_keys - std::min(_n_erased, _n_keys);
+}
+
 seastar::future<> storage_header::write(seastar::temporary_buffer<char> buffer) {
     return btree_header::write(buffer.share()).then([this, buffer{buffer.share()}]() mutable {
+        buffer.trim_front(btree_header::size());
+        memcpy(&_wal_segment, buffer.begin(), sizeof(_wal_segment));
+        buffer.trim_front(sizeof(_wal_segment));
+        memcpy(&_redo_lsn, buffer.begin(), sizeof(_redo_lsn));
+        buffer.trim_front(sizeof(_redo_lsn));
+        memcpy(&_data_page_size, buffer.begin(), sizeof(_data_page_size));
+        buffer.trim_front(sizeof(_data_page_size));
+        memcpy(&_filter_page, buffer.begin(), sizeof(_filter_page));
+        buffer.trim_front(sizeof(_filter_page));
+        memcpy(&_filter_checksum, buffer.begin(), sizeof(_filter_checksum));
+        buffer.trim_front(sizeof(_filter_checksum));
         if (!_available_page_list) {
             return seastar::now();
         }
-        buffer.trim_front(btree_header::size());
         return _available_page_list->write(buffer.share());
     });
 }
 
 seastar::future<> storage_header::read(seastar::temporary_buffer<char> buffer) {
     return btree_header::read(buffer.share()).then([this, buffer{buffer.share()}]() mutable {
+        buffer.trim_front(btree_header::size());
+        memcpy(buffer.get_write(), &_wal_segment, sizeof(_wal_segment));
+        buffer.trim_front(sizeof(_wal_segment));
+        memcpy(buffer.get_write(), &_redo_lsn, sizeof(_redo_lsn));
+        buffer.trim_front(sizeof(_redo_lsn));
+        memcpy(buffer.get_write(), &_data_page_size, sizeof(_data_page_size));
+        buffer.trim_front(sizeof(_data_page_size));
+        memcpy(buffer.get_write(), &_filter_page, sizeof(_filter_page));
+        buffer.trim_front(sizeof(_filter_page));
+        memcpy(buffer.get_write(), &_filter_checksum, sizeof(_filter_checksum));
+        buffer.trim_front(sizeof(_filter_checksum));
         if (!_available_page_list) {
             return seastar::now();
         }
-        buffer.trim_front(btree_header::size());
         return _available_page_list->read(buffer.share());
     });
 }
 
-storage_impl::storage_impl(std::string name, spiderdb_config config) : btree_impl{std::move(name), std::move(config)} {}
+storage_impl::storage_impl(std::string name, spiderdb_config config) : btree_impl{std::move(name), std::move(config)} {
+    // The log is replayed against the last checkpoint, so pages must not reach the disk in between
+    _no_steal = true;
+    for (size_t i = 0; i < key_lock_count(); ++i) {
+        _key_locks.emplace_back(1);
+    }
+}
 
 seastar::future<> storage_impl::open() {
     if (is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::file_already_opened});
     }
-    return btree_impl::open().then([this] {
+    if (!is_valid_page_size(_config.data_page_size)) {
+        return seastar::make_exception_future<>(std::invalid_argument("Data page size is not a multiple of the page size"));
+    }
+    // Checkpoints started by the writeback fiber wait until the log is replayed
+    return _checkpoint_lock.read_lock().then([this] {
+        return btree_impl::open();
+    }).then([this] {
         _storage_header = seastar::dynamic_pointer_cast<storage_header>(_btree_header);
+        // Data pages keep the size they were created with, which an existing file checks while it is opened
+        if (_created) {
+            _storage_header->_data_page_size = _config.data_page_size;
+            _storage_header->_dirty = true;
+        }
         _storage_header->_available_page_list = std::make_unique<available_page_list>(_config.max_available_pages);
         _storage_header->_available_page_list->set_min_available_space(_config.min_available_space);
+        if (_config.value_cache_size > 0) {
+            _value_cache = std::make_unique<value_cache>(_config.value_cache_size, _config.max_cached_value_size);
+        }
         auto evictor = [](const std::pair<page_id, data_page>& evicted_item) -> seastar::future<> {
             auto evicted_data_page = evicted_item.second;
             return evicted_data_page.flush().finally([evicted_data_page] {});
         };
-        _cache = std::make_unique<cache<page_id, data_page>>(_config.n_cached_data_pages, std::move(evictor));
+        _cache = make_cache<page_id, data_page>(_config.data_page_cache_policy, _config.n_cached_data_pages, std::move(evictor));
+        _buffer_manager.add_shrinker([this] {
+            return _cache->shrink();
+        });
+        // Replayed inserts must reach the filter
+        return load_filter();
+    }).then([this] {
+        _wal = std::make_unique<write_ahead_log>(get_name(), _config);
+        write_ahead_log::redo_function redo_function = nullptr;
+        if (!_created) {
+            redo_function = [this](auto record) {
+                return redo(std::move(record));
+            };
+        }
+        return _wal->open(_storage_header->_wal_segment, _storage_header->_redo_lsn, std::move(redo_function));
+    }).finally([this] {
+        _checkpoint_lock.read_unlock();
+    }).then([this](auto n_records) {
+        _lsn = _wal->get_last_lsn();
+        if (n_records == 0) {
+            return seastar::now();
+        }
+        SPIDERDB_LOGGER_INFO("Replayed {} WAL records", n_records);
+        // Make the replayed state the new redo point
+        return checkpoint();
+    }).then([this] {
+        // Files without a persisted filter get one in the background
+        rebuild_filter();
+        start_warm_up();
         SPIDERDB_LOGGER_INFO("Created storage");
     });
 }
 
 seastar::future<> storage_impl::flush() {
-    return seastar::parallel_for_each(_cache->get_all_items(), [](auto item) {
+    return seastar::parallel_for_each(_cache->get_items(), [](auto item) {
         auto data_page = item.second;
         return data_page.flush().finally([data_page] {});
     }).then([this] {
@@ -136,12 +386,287 @@ seastar::future<> storage_impl::close() {
     if (!is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
-    return btree_impl::close().then([] {
+    return std::exchange(_wal_checkpoint, seastar::make_ready_future<>()).then([this] {
+        return std::exchange(_filter_rebuild, seastar::make_ready_future<>());
+    }).then([this] {
+        return btree_impl::close();
+    }).then([this] {
+        _value_cache = nullptr;
+        _filter = nullptr;
+        return _wal->close();
+    }).then([] {
         SPIDERDB_LOGGER_INFO("Closed storage");
     });
 }
 
-seastar::future<> storage_impl::insert(string&& key, string&& value) {
+seastar::future<> storage_impl::insert(string&& key, string&& value, durability level) {
+    return log_and_apply(wal_operation::insert, std::move(key), std::move(value), level);
+}
+
+seastar::future<> storage_impl::update(string&& key, string&& value, durability level) {
+    if (!may_contain(key)) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::key_not_exists});
+    }
+    return log_and_apply(wal_operation::update, std::move(key), std::move(value), level);
+}
+
+seastar::future<> storage_impl::erase(string&& key, durability level) {
+    if (!may_contain(key)) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::key_not_exists});
+    }
+    return log_and_apply(wal_operation::erase, std::move(key), string{}, level);
+}
+
+seastar::future<string> storage_impl::select(string&& key) {
+    if (!may_contain(key)) {
+        return seastar::make_exception_future<string>(spiderdb_error{error_code::key_not_exists});
+    }
+    if (!_value_cache) {
+        return find(key.clone()).then([this](auto ptr) mutable {
+            return find_value(ptr);
+        });
+    }
+    auto cached_value = _value_cache->get(key);
+    if (cached_value) {
+        return seastar::make_ready_future<string>(std::move(*cached_value));
+    }
+    const auto write_count = _write_count;
+    return find(key.clone()).then([this](auto ptr) mutable {
+        return find_value(ptr);
+    }).then([this, key{std::move(key)}, write_count](auto value) {
+        // A write since the lookup started may have changed the value
+        if (_value_cache && _write_count == write_count) {
+            _value_cache->put(key, value);
+        }
+        return seastar::make_ready_future<string>(std::move(value));
+    });
+}
+
+seastar::future<> storage_impl::commit(durability level) {
+    checkpoint_wal();
+    const auto lsn = _wal->get_last_lsn();
+    switch (level) {
+        case durability::in_memory: {
+            if (_wal->get_pending_size() < _config.wal_buffer_size) {
+                return seastar::now();
+            }
+            return _wal->write(lsn);
+        }
+        case durability::buffered: {
+            return _wal->write(lsn);
+        }
+        default: {
+            return _wal->sync(lsn);
+        }
+    }
+}
+
+void storage_impl::log() const noexcept {
+    btree_impl::log();
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Data page size: ", _storage_header->_data_page_size);
+    if (_value_cache) {
+        SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Cached values: ", _value_cache->get_count());
+        SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Value cache size: ", _value_cache->get_size());
+    }
+    if (_filter) {
+        SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Filter keys: ", _filter->get_key_count());
+        SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Filter size: ", _filter->size());
+    }
+    if (_wal) {
+        _wal->log();
+    }
+}
+
+bool storage_impl::is_open() const noexcept {
+    return btree_impl::is_open();
+}
+
+seastar::shared_ptr<file_header> storage_impl::get_new_file_header() {
+    return seastar::make_shared<storage_header>();
+}
+
+seastar::shared_ptr<page_header> storage_impl::get_new_page_header() {
+    return seastar::make_shared<data_page_header>();
+}
+
+seastar::future<> storage_impl::check_header() {
+    return btree_impl::check_header().then([this] {
+        auto header = seastar::dynamic_pointer_cast<storage_header>(_file_header);
+        _config.data_page_size = header->_data_page_size;
+        if (!is_valid_page_size(_config.data_page_size)) {
+            return seastar::make_exception_future<>(std::invalid_argument("Data page size is not a multiple of the page size"));
+        }
+        return seastar::now();
+    });
+}
+
+seastar::future<> storage_impl::checkpoint() {
+    // Writes wait until the pages are on disk, so that the checkpoint holds every operation before the redo point and
+    // none after it
+    return seastar::with_lock(_checkpoint_lock.for_write(), [this] {
+        // Records appended from now on go to a new segment, which becomes the redo point
+        return _wal->rotate().then([this] {
+            _storage_header->_wal_segment = _wal->get_segment();
+            _storage_header->_redo_lsn = _wal->get_last_lsn();
+            // The filter must cover every key written before the redo point
+            return write_filter();
+        }).then([this](auto stale_filter_page) {
+            // Unlike flush, keep the data pages cached
+            return seastar::parallel_for_each(_cache->get_items(), [](auto item) {
+                auto data_page = item.second;
+                return data_page.flush().finally([data_page] {});
+            }).then([this] {
+                return btree_impl::checkpoint();
+            }).then([this, stale_filter_page] {
+                // Only released once the header that refers to the new filter is synced, which the checkpoint does
+                // before it returns
+                if (stale_filter_page == null_page) {
+                    return seastar::now();
+                }
+                return unlink_pages_from(stale_filter_page);
+            });
+        }).then([this] {
+            // Segments before the redo point are covered by the checkpoint
+            return _wal->remove_segments_before(_storage_header->_wal_segment);
+        });
+    });
+}
+
+seastar::future<> storage_impl::sync_log(uint64_t lsn) {
+    return _wal->sync(lsn);
+}
+
+seastar::future<> storage_impl::read_ahead_values(node leaf) {
+    if (leaf.get_page().get_type() != node_type::leaf) {
+        return seastar::now();
+    }
+    std::unordered_set<page_id> data_pages;
+    for (const auto& pointer : leaf.get_pointer_list()) {
+        data_pages.insert(get_page_id(pointer.pointer));
+    }
+    return seastar::do_with(std::move(data_pages), [this](auto& data_pages) {
+        return seastar::parallel_for_each(data_pages, [this](auto id) {
+            return seastar::with_semaphore(_read_ahead_limit, 1, [this, id] {
+                return get_data_page(id).discard_result();
+            });
+        });
+    });
+}
+
+void storage_impl::get_warm_pages(std::vector<std::pair<page_id, page_type>>& pages) const {
+    btree_impl::get_warm_pages(pages);
+    for (const auto& item : _cache->get_items()) {
+        pages.emplace_back(item.first, page_type::data);
+    }
+}
+
+seastar::future<> storage_impl::warm_up_page(page_id id, page_type type) {
+    if (type != page_type::data) {
+        return btree_impl::warm_up_page(id, type);
+    }
+    return get_or_create_page(id, _config.data_page_size).then([this](auto page) {
+        // The page may have been reused since the snapshot was taken
+        if (page.get_type() != page_type::data) {
+            return seastar::now();
+        }
+        return get_data_page(page.get_id()).discard_result().finally([page] {});
+    });
+}
+
+void storage_impl::checkpoint_wal() {
+    if (_checkpointing || _wal->get_segment_size() < _config.max_wal_segment_size) {
+        return;
+    }
+    _checkpointing = true;
+    rebuild_filter();
+    _wal_checkpoint = checkpoint().handle_exception([](auto ex) {
+        SPIDERDB_LOGGER_ERROR("Failed to checkpoint the WAL: {}", ex);
+    }).finally([this] {
+        _checkpointing = false;
+    });
+}
+
+seastar::future<> storage_impl::redo(wal_record record) {
+    // The file holds the state at the redo point and records are replayed in the order they were applied. Records
+    // were validated before they were logged, and those whose apply failed were aborted in the log and are not
+    // replayed, so every record applies cleanly.
+    _lsn = record._lsn;
+    return apply(record._operation, std::move(record._key), std::move(record._value));
+}
+
+seastar::future<> storage_impl::log_and_apply(wal_operation operation, string&& key, string&& value, durability level) {
+    return throttle_writes().then([this, operation, key{std::move(key)}, value{std::move(value)}]() mutable {
+        auto& key_lock = _key_locks[bloom_filter::get_hash(key) % _key_locks.size()];
+        return seastar::with_semaphore(key_lock, 1, [this, operation, key{std::move(key)}, value{std::move(value)}]() mutable {
+            return seastar::with_lock(_checkpoint_lock.for_read(), [this, operation, key{std::move(key)}, value{std::move(value)}]() mutable {
+                // The key lock keeps the outcome of the validation until the record is applied
+                return validate(operation, key).then([this, operation, key{std::move(key)}, value{std::move(value)}]() mutable {
+                    // Logged before any page changes, so that pages are stamped with the record that covers them
+                    const auto lsn = _lsn = _wal->append(_wal->prepare(operation, key, value));
+                    return apply(operation, std::move(key), std::move(value)).handle_exception([this, lsn](auto ex) {
+                        // The client is told the write failed, so it must not come back when the log is replayed
+                        _lsn = _wal->append(_wal->prepare_abort(lsn));
+                        return seastar::make_exception_future<>(ex);
+                    });
+                });
+            });
+        });
+    }).then_wrapped([this, level](auto fut) {
+        if (!fut.failed()) {
+            return commit(level);
+        }
+        // Committed all the same, so that an abort record is as durable as the record it aborts
+        auto ex = fut.get_exception();
+        return commit(level).then([ex] {
+            return seastar::make_exception_future<>(ex);
+        });
+    });
+}
+
+seastar::future<> storage_impl::validate(wal_operation operation, const string& key) {
+    // Keys the filter rules out need no lookup to be inserted
+    if (operation == wal_operation::insert && !may_contain(key)) {
+        return seastar::now();
+    }
+    return find(key.clone()).then_wrapped([operation](auto fut) {
+        const bool expected = (operation != wal_operation::insert);
+        if (!fut.failed()) {
+            fut.ignore_ready_future();
+            return expected ? seastar::now() : seastar::make_exception_future<>(spiderdb_error{error_code::key_exists});
+        }
+        auto ex = fut.get_exception();
+        if (!expected && has_error_code(ex, error_code::key_not_exists)) {
+            return seastar::now();
+        }
+        return seastar::make_exception_future<>(ex);
+    });
+}
+
+seastar::future<> storage_impl::apply(wal_operation operation, string&& key, string&& value) {
+    return seastar::futurize_invoke([this, operation, key{std::move(key)}, value{std::move(value)}]() mutable {
+        switch (operation) {
+            case wal_operation::insert: {
+                return apply_insert(std::move(key), std::move(value));
+            }
+            case wal_operation::update: {
+                return apply_update(std::move(key), std::move(value));
+            }
+            case wal_operation::erase: {
+                return apply_erase(std::move(key));
+            }
+            default: {
+                return seastar::now();
+            }
+        }
+    }).finally([this] {
+        // Counted again once applied, as a lookup started after the invalidation may still have read the old value
+        ++_write_count;
+    });
+}
+
+seastar::future<> storage_impl::apply_insert(string&& key, string&& value) {
+    invalidate_value(key);
+    add_to_filter(key);
     return add_value(std::move(value)).then([this, key{std::move(key)}](auto ptr) mutable {
         return add(std::move(key), ptr).handle_exception([this, ptr](auto ex) {
             return remove_value(ptr).then([ex] {
@@ -151,38 +676,172 @@ seastar::future<> storage_impl::insert(string&& key, string&& value) {
     });
 }
 
-seastar::future<> storage_impl::update(string&& key, string&& value) {
-    return find(key.clone()).then([this, value{value.clone()}](auto ptr) mutable {
+seastar::future<> storage_impl::apply_update(string&& key, string&& value) {
+    // Hot keys stay cached with their new value
+    const bool cached = _value_cache && _value_cache->contains(key);
+    invalidate_value(key);
+    auto cached_value = cached ? std::make_optional(value.clone()) : std::nullopt;
+    return find(key.clone()).then([this, value{std::move(value)}](auto ptr) mutable {
         return update_value(ptr, std::move(value));
+    }).then([this, key{std::move(key)}, cached_value{std::move(cached_value)}, write_count{_write_count}] {
+        if (cached_value && _value_cache && _write_count == write_count) {
+            _value_cache->put(key, *cached_value);
+        }
     });
 }
 
-seastar::future<> storage_impl::erase(string&& key) {
+seastar::future<> storage_impl::apply_erase(string&& key) {
+    invalidate_value(key);
     return remove(std::move(key)).then([this](auto ptr) {
+        remove_from_filter();
         return remove_value(ptr);
     });
 }
 
-seastar::future<string> storage_impl::select(string&& key) {
-    return find(key.clone()).then([this, key{std::move(key)}](auto ptr) mutable {
-        return find_value(ptr);
-    });
+void storage_impl::invalidate_value(const string& key) {
+    ++_write_count;
+    if (_value_cache) {
+        _value_cache->erase(key);
+    }
 }
 
-void storage_impl::log() const noexcept {
-    btree_impl::log();
+bool storage_impl::may_contain(const string& key) const {
+    return !_filter || _filter->may_contain(bloom_filter::get_hash(key));
 }
 
-bool storage_impl::is_open() const noexcept {
-    return btree_impl::is_open();
+void storage_impl::add_to_filter(const string& key) {
+    const auto hash = bloom_filter::get_hash(key);
+    if (_filter) {
+        _filter->add(hash);
+        _filter_dirty = true;
+    }
+    if (_rebuilding_filter) {
+        _rebuilt_filter_hashes.push_back(hash);
+    }
 }
 
-seastar::shared_ptr<file_header> storage_impl::get_new_file_header() {
-    return seastar::make_shared<storage_header>();
+void storage_impl::remove_from_filter() {
+    if (_filter) {
+        _filter->mark_erased();
+        _filter_dirty = true;
+    }
+    if (_rebuilding_filter) {
+        // A merge may have moved keys into a leaf that was already scanned
+        _filter_rebuild_stale = true;
+    }
 }
 
-seastar::shared_ptr<page_header> storage_impl::get_new_page_header() {
-    return seastar::make_shared<data_page_header>();
+void storage_impl::rebuild_filter() {
+    if (_config.bloom_filter_bits_per_key == 0 || _rebuilding_filter || (_filter && !_filter->need_rebuild())) {
+        return;
+    }
+    _rebuilding_filter = true;
+    _filter_rebuild_stale = false;
+    _filter_rebuild = scan_keys().then([this] {
+        if (_filter_rebuild_stale) {
+            // Retried on a later checkpoint, the current filter is still valid
+            SPIDERDB_LOGGER_DEBUG("Discarded Bloom filter rebuild");
+            return;
+        }
+        const auto capacity = std::max<uint64_t>(_config.min_bloom_filter_keys, _rebuilt_filter_hashes.size() * 2);
+        auto filter = std::make_unique<bloom_filter>(capacity, _config.bloom_filter_bits_per_key);
+        for (auto hash : _rebuilt_filter_hashes) {
+            filter->add(hash);
+        }
+        _filter = std::move(filter);
+        _filter_dirty = true;
+        SPIDERDB_LOGGER_INFO("Rebuilt Bloom filter with {} keys", _rebuilt_filter_hashes.size());
+    }).handle_exception([](auto ex) {
+        SPIDERDB_LOGGER_ERROR("Failed to rebuild the Bloom filter: {}", ex);
+    }).finally([this] {
+        _rebuilt_filter_hashes = {};
+        _rebuilding_filter = false;
+    });
+}
+
+seastar::future<> storage_impl::load_filter() {
+    const auto filter_page = _storage_header->_filter_page;
+    if (_config.bloom_filter_bits_per_key == 0) {
+        if (filter_page == null_page) {
+            return seastar::now();
+        }
+        // The filter would miss the keys inserted while it is disabled
+        _storage_header->_filter_page = null_page;
+        _storage_header->_dirty = true;
+        return unlink_pages_from(filter_page);
+    }
+    if (_created) {
+        _filter = std::make_unique<bloom_filter>(_config.min_bloom_filter_keys, _config.bloom_filter_bits_per_key);
+        _filter_dirty = true;
+        return seastar::now();
+    }
+    if (filter_page == null_page) {
+        return seastar::now();
+    }
+    return read(filter_page).then([this](auto data) {
+        if (bloom_filter::get_hash(data) != _storage_header->_filter_checksum) {
+            // Left empty, so that the filter gets rebuilt
+            SPIDERDB_LOGGER_WARN("Discarded a corrupt Bloom filter");
+            return seastar::now();
+        }
+        auto filter = std::make_unique<bloom_filter>();
+        return filter->write(seastar::temporary_buffer<char>{data.c_str(), data.length()}).then([this, filter{std::move(filter)}]() mutable {
+            if (!filter->empty()) {
+                _filter = std::move(filter);
+            }
+        });
+    });
+}
+
+seastar::future<page_id> storage_impl::write_filter() {
+    if (!_filter || !_filter_dirty) {
+        return seastar::make_ready_future<page_id>(null_page);
+    }
+    // Written to new pages so that a crash never leaves a torn filter behind
+    _filter_dirty = false;
+    seastar::temporary_buffer<char> buffer{_filter->size()};
+    return _filter->read(buffer.share()).then([this, buffer{std::move(buffer)}]() mutable {
+        string data{buffer.get(), buffer.size()};
+        const auto checksum = bloom_filter::get_hash(data);
+        return write(std::move(data)).then([checksum](auto filter_page) {
+            return std::make_pair(filter_page, checksum);
+        });
+    }).then([this](auto filter) {
+        const auto filter_page = filter.first;
+        _storage_header->_filter_checksum = filter.second;
+        _storage_header->_dirty = true;
+        return seastar::make_ready_future<page_id>(std::exchange(_storage_header->_filter_page, filter_page));
+    }).handle_exception([this](auto ex) {
+        _filter_dirty = true;
+        return seastar::make_exception_future<page_id>(ex);
+    });
+}
+
+seastar::future<> storage_impl::scan_keys() {
+    return seastar::do_with(get_root(), [this](auto& current) {
+        // Descend to the leftmost leaf
+        return seastar::do_until([&current] {
+            return current.get_page().get_type() == node_type::leaf;
+        }, [this, &current] {
+            return get_node(current.get_pointer_list().front().child).then([&current](auto child) {
+                current = child;
+            });
+        }).then([this, &current] {
+            return seastar::repeat([this, &current] {
+                for (const auto& key : current.get_key_list()) {
+                    _rebuilt_filter_hashes.push_back(bloom_filter::get_hash(key));
+                }
+                const auto next = current.get_next_node();
+                if (next == null_node) {
+                    return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+                }
+                return get_node(next).then([&current](auto leaf) {
+                    current = leaf;
+                    return seastar::stop_iteration::no;
+                });
+            });
+        });
+    });
 }
 
 seastar::weak_ptr<storage_impl> storage_impl::get_pointer() noexcept {
@@ -190,7 +849,7 @@ seastar::weak_ptr<storage_impl> storage_impl::get_pointer() noexcept {
 }
 
 seastar::future<data_page> storage_impl::create_data_page() {
-    return get_free_page().then([this](auto page) mutable {
+    return get_free_page(_config.data_page_size).then([this](auto page) mutable {
         data_page new_data_page{page, get_pointer()};
         new_data_page.get_page().set_type(page_type::data);
         _data_pages.emplace(new_data_page.get_id(), new_data_page.get_pointer());
@@ -207,24 +866,33 @@ seastar::future<data_page> storage_impl::get_data_page(page_id id) {
         return _cache->get(id).then([](auto cached_data_page) {
             return seastar::make_ready_future<data_page>(cached_data_page);
         }).handle_exception([this, id](auto ex) {
-            return seastar::with_semaphore(_get_data_page_lock, 1, [this, id] {
-                // If data page has not been flushed
-                auto data_page_it = _data_pages.find(id);
-                if (data_page_it != _data_pages.end()) {
-                    if (data_page_it->second) {
-                        return seastar::make_ready_future<data_page>(data_page_it->second->shared_from_this());
-                    }
-                    _data_pages.erase(data_page_it);
+            // If data page has not been flushed
+            auto data_page_it = _data_pages.find(id);
+            if (data_page_it != _data_pages.end()) {
+                if (data_page_it->second) {
+                    return seastar::make_ready_future<data_page>(data_page_it->second->shared_from_this());
                 }
-                // Otherwise
-                return get_or_create_page(id).then([this](auto page) {
-                    auto loading_data_page = data_page{page, get_pointer()};
-                    return loading_data_page.load().then([this, loading_data_page] {
-                        _data_pages.emplace(loading_data_page.get_id(), loading_data_page.get_pointer());
-                        return seastar::make_ready_future<data_page>(loading_data_page);
-                    });
+                _data_pages.erase(data_page_it);
+            }
+            // If data page is being loaded by another request
+            auto loading_data_page_it = _loading_data_pages.find(id);
+            if (loading_data_page_it != _loading_data_pages.end()) {
+                return loading_data_page_it->second.get_future();
+            }
+            // Otherwise
+            seastar::shared_future<data_page> loading_data_page = get_or_create_page(id, _config.data_page_size).then([this](auto page) {
+                auto loaded_data_page = data_page{page, get_pointer()};
+                return loaded_data_page.load().then([this, loaded_data_page] {
+                    _data_pages.emplace(loaded_data_page.get_id(), loaded_data_page.get_pointer());
+                    return seastar::make_ready_future<data_page>(loaded_data_page);
                 });
+            }).finally([this, id] {
+                _loading_data_pages.erase(id);
             });
+            if (!loading_data_page.available()) {
+                _loading_data_pages.emplace(id, loading_data_page);
+            }
+            return loading_data_page.get_future();
         });
     }).then([this](auto loaded_data_page) mutable {
         return cache_data_page(loaded_data_page).then([loaded_data_page] {
@@ -234,6 +902,10 @@ seastar::future<data_page> storage_impl::get_data_page(page_id id) {
 }
 
 seastar::future<> storage_impl::cache_data_page(data_page data_page) {
+    // The access that found a resident data page has been counted already
+    if (_cache->peek(data_page.get_id())) {
+        return seastar::now();
+    }
     return _cache->put(data_page.get_id(), data_page);
 }
 
@@ -338,6 +1010,13 @@ seastar::future<> storage::close() const {
 }
 
 seastar::future<> storage::insert(string&& key, string&& value) const {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return insert(std::move(key), std::move(value), _impl->_config.default_durability);
+}
+
+seastar::future<> storage::insert(string&& key, string&& value, durability level) const {
     if (!_impl || !_impl->is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
@@ -350,10 +1029,17 @@ seastar::future<> storage::insert(string&& key, string&& value) const {
     if (value.empty()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::value_too_short});
     }
-    return _impl->insert(std::move(key), std::move(value));
+    return _impl->insert(std::move(key), std::move(value), level);
 }
 
 seastar::future<> storage::update(string&& key, string&& value) const {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return update(std::move(key), std::move(value), _impl->_config.default_durability);
+}
+
+seastar::future<> storage::update(string&& key, string&& value, durability level) const {
     if (!_impl || !_impl->is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
@@ -363,17 +1049,24 @@ seastar::future<> storage::update(string&& key, string&& value) const {
     if (value.empty()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::value_too_short});
     }
-    return _impl->update(std::move(key), std::move(value));
+    return _impl->update(std::move(key), std::move(value), level);
 }
 
 seastar::future<> storage::erase(string&& key) const {
+    if (!_impl) {
+        return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
+    }
+    return erase(std::move(key), _impl->_config.default_durability);
+}
+
+seastar::future<> storage::erase(string&& key, durability level) const {
     if (!_impl || !_impl->is_open()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::closed_error});
     }
     if (key.empty()) {
         return seastar::make_exception_future<>(spiderdb_error{error_code::key_too_short});
     }
-    return _impl->erase(std::move(key));
+    return _impl->erase(std::move(key), level);
 }
 
 seastar::future<string> storage::select(string&& key) const {
@@ -386,6 +1079,34 @@ seastar::future<string> storage::select(string&& key) const {
     return _impl->select(std::move(key));
 }
 
+void storage::start_sequential_scan() const {
+    if (!_impl || !_impl->is_open()) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    _impl->start_sequential_scan();
+}
+
+void storage::stop_sequential_scan() const {
+    if (!_impl || !_impl->is_open()) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    _impl->stop_sequential_scan();
+}
+
+uint64_t storage::get_resident_bytes() const {
+    if (!_impl) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    return _impl->get_resident_bytes();
+}
+
+uint64_t storage::get_dirty_bytes() const {
+    if (!_impl) {
+        throw spiderdb_error{error_code::closed_error};
+    }
+    return _impl->get_dirty_bytes();
+}
+
 void storage::log() const {
     if (!_impl || !_impl->is_open()) {
         throw spiderdb_error{error_code::closed_error};
@@ -0,0 +1,330 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#include <spiderdb/core/wal.h>
+#include <spiderdb/util/log.h>
+#include <spiderdb/util/error.h>
+#include <seastar/core/seastar.hh>
+#include <seastar/core/sleep.hh>
+#include <seastar/core/future-util.hh>
+
+namespace spiderdb {
+
+namespace {
+
+uint32_t get_checksum(const char* data, size_t len) {
+    // FNV-1a
+    uint32_t res = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        res ^= static_cast<unsigned char>(data[i]);
+        res *= 16777619u;
+    }
+    return res;
+}
+
+}
+
+write_ahead_log::write_ahead_log(std::string name, const spiderdb_config& config) : _name{std::move(name)}, _config{config} {}
+
+seastar::future<size_t> write_ahead_log::open(uint64_t first_segment, uint64_t redo_lsn, redo_function redo) {
+    _first_segment = first_segment;
+    _last_lsn = redo_lsn;
+    return seastar::do_with(first_segment, size_t{0}, std::move(redo), [this](auto& segment, auto& n_records, auto& redo) {
+        // Replay every segment left since the last checkpoint
+        return seastar::repeat([this, &segment, &n_records, &redo] {
+            return seastar::file_exists(get_segment_name(segment)).then([this, &segment, &n_records, &redo](auto exists) {
+                if (!exists) {
+                    return seastar::make_ready_future<seastar::stop_iteration>(seastar::stop_iteration::yes);
+                }
+                if (!redo) {
+                    // Left by a database file that no longer exists
+                    return seastar::remove_file(get_segment_name(segment++)).then([] {
+                        return seastar::stop_iteration::no;
+                    });
+                }
+                return replay_segment(segment, redo).then([&segment, &n_records](auto n_replayed_records) {
+                    n_records += n_replayed_records;
+                    ++segment;
+                    return seastar::stop_iteration::no;
+                });
+            });
+        }).then([this, &segment, &n_records] {
+            _written_lsn = _last_lsn;
+            _synced_lsn = _last_lsn;
+            return open_segment(segment).then([&n_records] {
+                return n_records;
+            });
+        });
+    });
+}
+
+seastar::future<> write_ahead_log::close() {
+    return seastar::with_semaphore(_sync_lock, 1, [this] {
+        return seastar::with_semaphore(_write_lock, 1, [this] {
+            return write_pending().then([this] {
+                return _file.flush();
+            }).then([this] {
+                _synced_lsn = _written_lsn;
+                auto file = std::move(_file);
+                return file.close().finally([file] {});
+            });
+        });
+    });
+}
+
+std::vector<char> write_ahead_log::prepare(wal_operation operation, const string& key, const string& value) const {
+    const uint32_t key_len = key.length();
+    const uint32_t value_len = value.length();
+    const uint32_t body_len = sizeof(operation) + sizeof(key_len) + key_len + sizeof(value_len) + value_len;
+    std::vector<char> record(record_header_size() + body_len, 0);
+    // The checksum and the LSN are stamped on append
+    auto pos = record.data();
+    memcpy(pos, &body_len, sizeof(body_len));
+    pos += record_header_size();
+    memcpy(pos, &operation, sizeof(operation));
+    pos += sizeof(operation);
+    memcpy(pos, &key_len, sizeof(key_len));
+    pos += sizeof(key_len);
+    memcpy(pos, key.c_str(), key_len);
+    pos += key_len;
+    memcpy(pos, &value_len, sizeof(value_len));
+    pos += sizeof(value_len);
+    if (value_len > 0) {
+        memcpy(pos, value.c_str(), value_len);
+    }
+    return record;
+}
+
+std::vector<char> write_ahead_log::prepare_abort(uint64_t lsn) const {
+    return prepare(wal_operation::abort, string{reinterpret_cast<const char*>(&lsn), sizeof(lsn)}, string{});
+}
+
+uint64_t write_ahead_log::append(std::vector<char>&& record) {
+    const auto lsn = ++_last_lsn;
+    auto lsn_pos = record.data() + sizeof(uint32_t) + sizeof(uint32_t);
+    memcpy(lsn_pos, &lsn, sizeof(lsn));
+    const auto checksum = get_checksum(lsn_pos, record.size() - sizeof(uint32_t) - sizeof(uint32_t));
+    memcpy(record.data() + sizeof(uint32_t), &checksum, sizeof(checksum));
+    _pending.insert(_pending.end(), record.begin(), record.end());
+    return lsn;
+}
+
+seastar::future<> write_ahead_log::write(uint64_t lsn) {
+    if (_written_lsn >= lsn) {
+        return seastar::now();
+    }
+    return seastar::with_semaphore(_write_lock, 1, [this, lsn] {
+        if (_written_lsn >= lsn) {
+            return seastar::now();
+        }
+        return write_pending();
+    });
+}
+
+seastar::future<> write_ahead_log::sync(uint64_t lsn) {
+    if (_synced_lsn >= lsn) {
+        return seastar::now();
+    }
+    if (!_sync_batch) {
+        _sync_batch = seastar::make_lw_shared<seastar::shared_promise<>>();
+        auto batch = _sync_batch;
+        // Writers arriving while the previous batch is in progress or within the window share this batch
+        (void)seastar::with_semaphore(_sync_lock, 1, [this] {
+            return seastar::sleep(_config.group_commit_window).then([this] {
+                _sync_batch = nullptr;
+                const auto lsn = _last_lsn;
+                return write(lsn).then([this] {
+                    return _file.flush();
+                }).then([this, lsn] {
+                    _synced_lsn = std::max(_synced_lsn, lsn);
+                });
+            });
+        }).then_wrapped([batch](auto f) {
+            if (f.failed()) {
+                batch->set_exception(f.get_exception());
+            } else {
+                batch->set_value();
+            }
+        });
+    }
+    return _sync_batch->get_shared_future();
+}
+
+seastar::future<> write_ahead_log::rotate() {
+    return seastar::with_semaphore(_sync_lock, 1, [this] {
+        return seastar::with_semaphore(_write_lock, 1, [this] {
+            return write_pending().then([this] {
+                return _file.flush();
+            }).then([this] {
+                _synced_lsn = _written_lsn;
+                auto file = std::move(_file);
+                return file.close().finally([file] {});
+            }).then([this] {
+                return open_segment(_segment + 1);
+            });
+        });
+    });
+}
+
+seastar::future<> write_ahead_log::remove_segments_before(uint64_t segment) {
+    return seastar::do_until([this, segment] {
+        return _first_segment >= std::min(segment, _segment);
+    }, [this] {
+        auto segment_name = get_segment_name(_first_segment++);
+        return seastar::file_exists(segment_name).then([segment_name](auto exists) {
+            if (!exists) {
+                return seastar::now();
+            }
+            return seastar::remove_file(segment_name);
+        });
+    });
+}
+
+uint64_t write_ahead_log::get_last_lsn() const noexcept {
+    return _last_lsn;
+}
+
+uint64_t write_ahead_log::get_segment() const noexcept {
+    return _segment;
+}
+
+uint64_t write_ahead_log::get_segment_size() const noexcept {
+    return _segment_size + _pending.size();
+}
+
+size_t write_ahead_log::get_pending_size() const noexcept {
+    return _pending.size();
+}
+
+void write_ahead_log::log() const noexcept {
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "WAL segment: ", _segment);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "WAL size: ", get_segment_size());
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Last LSN: ", _last_lsn);
+    SPIDERDB_LOGGER_TRACE("\t{:<18}{:>20}", "Synced LSN: ", _synced_lsn);
+}
+
+std::string write_ahead_log::get_segment_name(uint64_t segment) const {
+    return fmt::format("{}.wal-{}", _name, segment);
+}
+
+seastar::future<> write_ahead_log::open_segment(uint64_t segment) {
+    const auto flags = seastar::open_flags::create | seastar::open_flags::truncate | seastar::open_flags::rw;
+    return seastar::open_file_dma(get_segment_name(segment), flags).then([this, segment](auto file) {
+        _file = file;
+        _segment = segment;
+        _segment_size = 0;
+        SPIDERDB_LOGGER_DEBUG("Opened WAL segment: {}", get_segment_name(segment));
+    });
+}
+
+seastar::future<size_t> write_ahead_log::replay_segment(uint64_t segment, redo_function& redo) {
+    return seastar::open_file_dma(get_segment_name(segment), seastar::open_flags::ro).then([this, &redo](auto file) {
+        return file.size().then([file](auto size) mutable {
+            return file.dma_read_bulk<char>(0, size);
+        }).then([this, &redo, alignment{file.disk_write_dma_alignment()}](auto buffer) {
+            std::vector<wal_record> records;
+            uint64_t pos = 0;
+            uint64_t prev_lsn = 0;
+            while (buffer.size() >= record_header_size()) {
+                uint32_t body_len;
+                memcpy(&body_len, buffer.begin(), sizeof(body_len));
+                if (body_len == 0 && pos % alignment != 0) {
+                    // Padding after the last record of a write, the next write starts at the next block
+                    const auto padding = std::min<uint64_t>(alignment - pos % alignment, buffer.size());
+                    buffer.trim_front(padding);
+                    pos += padding;
+                    continue;
+                }
+                if (body_len == 0 || buffer.size() - record_header_size() < body_len) {
+                    // End of the log or a torn write
+                    break;
+                }
+                uint32_t checksum;
+                memcpy(&checksum, buffer.begin() + sizeof(body_len), sizeof(checksum));
+                auto lsn_pos = buffer.begin() + sizeof(body_len) + sizeof(checksum);
+                if (checksum != get_checksum(lsn_pos, sizeof(uint64_t) + body_len)) {
+                    break;
+                }
+                wal_record record;
+                memcpy(&record._lsn, lsn_pos, sizeof(record._lsn));
+                if (prev_lsn > 0 && record._lsn != prev_lsn + 1) {
+                    // A block lost in the middle of a torn write, the records after it were never acknowledged
+                    break;
+                }
+                prev_lsn = record._lsn;
+                pos += record_header_size() + body_len;
+                buffer.trim_front(record_header_size());
+                memcpy(&record._operation, buffer.begin(), sizeof(record._operation));
+                buffer.trim_front(sizeof(record._operation));
+                uint32_t key_len;
+                memcpy(&key_len, buffer.begin(), sizeof(key_len));
+                buffer.trim_front(sizeof(key_len));
+                record._key = string{buffer.begin(), key_len};
+                buffer.trim_front(key_len);
+                uint32_t value_len;
+                memcpy(&value_len, buffer.begin(), sizeof(value_len));
+                buffer.trim_front(sizeof(value_len));
+                record._value = string{buffer.begin(), value_len};
+                buffer.trim_front(value_len);
+                if (record._lsn <= _last_lsn) {
+                    // Already covered by the last checkpoint
+                    continue;
+                }
+                _last_lsn = record._lsn;
+                if (record._operation == wal_operation::abort) {
+                    // Aborted before the next checkpoint, so the aborted record is in this segment
+                    uint64_t aborted_lsn;
+                    memcpy(&aborted_lsn, record._key.c_str(), sizeof(aborted_lsn));
+                    auto it = std::find_if(records.rbegin(), records.rend(), [aborted_lsn](const auto& aborted_record) {
+                        return aborted_record._lsn == aborted_lsn;
+                    });
+                    if (it != records.rend()) {
+                        records.erase(std::next(it).base());
+                    }
+                    continue;
+                }
+                records.push_back(std::move(record));
+            }
+            return seastar::do_with(std::move(records), [&redo](auto& records) {
+                return seastar::do_for_each(records, [&redo](auto& record) {
+                    return redo(std::move(record));
+                }).then([&records] {
+                    return records.size();
+                });
+            });
+        }).finally([file]() mutable {
+            return file.close().finally([file] {});
+        });
+    });
+}
+
+seastar::future<> write_ahead_log::write_pending() {
+    if (_pending.empty()) {
+        return seastar::now();
+    }
+    auto pending = std::move(_pending);
+    _pending.clear();
+    const auto lsn = _last_lsn;
+    // Every write starts a fresh block, so that a torn write never reaches records synced before it. The rest of its
+    // last block is zeroed, which replay skips.
+    const uint64_t alignment = _file.disk_write_dma_alignment();
+    const uint64_t offset = _segment_size;
+    const uint64_t len = pending.size();
+    const uint64_t aligned_len = (len + alignment - 1) / alignment * alignment;
+    auto buffer = seastar::temporary_buffer<char>::aligned(_file.memory_dma_alignment(), aligned_len);
+    memcpy(buffer.get_write(), pending.data(), len);
+    memset(buffer.get_write() + len, 0, aligned_len - len);
+    auto data = buffer.get();
+    return _file.dma_write(offset, data, aligned_len).then([this, lsn, aligned_len, buffer{std::move(buffer)}](auto) {
+        _segment_size += aligned_len;
+        _written_lsn = lsn;
+    }).handle_exception([this, pending{std::move(pending)}](auto ex) mutable {
+        // Keep the records so that a later write retries them
+        _pending.insert(_pending.begin(), pending.begin(), pending.end());
+        SPIDERDB_LOGGER_ERROR("Failed to write WAL segment {}: {}", _segment, ex);
+        return seastar::make_exception_future<>(ex);
+    });
+}
+
+}
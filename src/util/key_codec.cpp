@@ -0,0 +1,142 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#include <spiderdb/util/key_codec.h>
+#include <stdexcept>
+
+namespace spiderdb {
+
+namespace {
+
+// Strings end with 0x00 0x01, and 0x00 inside them is written as 0x00 0xff, so that a string sorts before every
+// string it is a prefix of
+constexpr char string_escape = '\x00';
+constexpr char string_escaped_zero = '\xff';
+constexpr char string_terminator = '\x01';
+constexpr size_t fixed_length = sizeof(uint64_t);
+
+uint64_t to_ordered_bits(double val) noexcept {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    // Negative numbers have every bit flipped, so that their order is reversed, and positive ones only the sign bit
+    return (bits >> 63) ? ~bits : bits ^ (uint64_t{1} << 63);
+}
+
+double from_ordered_bits(uint64_t bits) noexcept {
+    bits = (bits >> 63) ? bits ^ (uint64_t{1} << 63) : ~bits;
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+}
+
+key_encoder& key_encoder::add_uint64(uint64_t val, key_order order) {
+    // Big-endian, so that the byte order matches the numeric order
+    char data[fixed_length];
+    for (size_t i = 0; i < fixed_length; ++i) {
+        data[i] = static_cast<char>(val >> (56 - 8 * i));
+    }
+    append(data, fixed_length, order);
+    return *this;
+}
+
+key_encoder& key_encoder::add_int64(int64_t val, key_order order) {
+    // Flipping the sign bit moves negative numbers before positive ones
+    return add_uint64(static_cast<uint64_t>(val) ^ (uint64_t{1} << 63), order);
+}
+
+key_encoder& key_encoder::add_double(double val, key_order order) {
+    return add_uint64(to_ordered_bits(val), order);
+}
+
+key_encoder& key_encoder::add_string(const string& val, key_order order) {
+    std::vector<char> data;
+    data.reserve(val.length() + 2);
+    for (size_t i = 0; i < val.length(); ++i) {
+        data.push_back(val.c_str()[i]);
+        if (val.c_str()[i] == string_escape) {
+            data.push_back(string_escaped_zero);
+        }
+    }
+    data.push_back(string_escape);
+    data.push_back(string_terminator);
+    append(data.data(), data.size(), order);
+    return *this;
+}
+
+string key_encoder::get() const {
+    return string{_data.data(), _data.size()};
+}
+
+void key_encoder::clear() noexcept {
+    _data.clear();
+}
+
+void key_encoder::append(const char* data, size_t len, key_order order) {
+    const auto pos = _data.size();
+    _data.insert(_data.end(), data, data + len);
+    if (order == key_order::descending) {
+        // Inverting the bytes of a field reverses its order
+        for (auto i = pos; i < _data.size(); ++i) {
+            _data[i] = static_cast<char>(~_data[i]);
+        }
+    }
+}
+
+key_decoder::key_decoder(const string& key) : _key{key.clone()} {}
+
+uint64_t key_decoder::get_uint64(key_order order) {
+    return get_fixed(order);
+}
+
+int64_t key_decoder::get_int64(key_order order) {
+    return static_cast<int64_t>(get_fixed(order) ^ (uint64_t{1} << 63));
+}
+
+double key_decoder::get_double(key_order order) {
+    return from_ordered_bits(get_fixed(order));
+}
+
+string key_decoder::get_string(key_order order) {
+    const char mask = (order == key_order::descending) ? '\xff' : '\x00';
+    std::vector<char> data;
+    while (true) {
+        if (_pos + 1 >= _key.length()) {
+            throw std::invalid_argument("Key codec: Unterminated string");
+        }
+        const char c = static_cast<char>(_key.c_str()[_pos++] ^ mask);
+        if (c != string_escape) {
+            data.push_back(c);
+            continue;
+        }
+        const char next = static_cast<char>(_key.c_str()[_pos++] ^ mask);
+        if (next == string_terminator) {
+            break;
+        }
+        if (next != string_escaped_zero) {
+            throw std::invalid_argument("Key codec: Invalid escape");
+        }
+        data.push_back(string_escape);
+    }
+    return string{data.data(), data.size()};
+}
+
+bool key_decoder::empty() const noexcept {
+    return _pos >= _key.length();
+}
+
+uint64_t key_decoder::get_fixed(key_order order) {
+    if (_pos + fixed_length > _key.length()) {
+        throw std::invalid_argument("Key codec: Truncated field");
+    }
+    uint64_t val = 0;
+    for (size_t i = 0; i < fixed_length; ++i) {
+        val |= static_cast<uint64_t>(static_cast<unsigned char>(_key.c_str()[_pos + i])) << (56 - 8 * i);
+    }
+    _pos += fixed_length;
+    return (order == key_order::descending) ? ~val : val;
+}
+
+}
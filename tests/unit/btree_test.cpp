@@ -5,6 +5,7 @@
 #define SPIDERDB_USING_MASTER_TEST_SUITE
 #include <spiderdb/core/btree.h>
 #include <spiderdb/util/error.h>
+#include <spiderdb/util/key_codec.h>
 #include <spiderdb/testing/test_case.h>
 #include <boost/iterator/counting_iterator.hpp>
 
@@ -35,6 +36,8 @@ uint8_t get_number_of_digits(size_t num) {
 const size_t N_RECORDS = 10000; // 100000;
 const size_t SHORT_KEY_LEN = get_number_of_digits(N_RECORDS) + 1;
 const size_t LONG_KEY_LEN = 1000;
+const size_t N_SCANNED_RECORDS = 1 << 13;
+const size_t N_HOT_RECORDS = 4;
 
 struct data_generator {
     using key_t = spiderdb::string;
@@ -54,6 +57,17 @@ public:
         }
     }
 
+    void generate_fixed_width_data(size_t n_items, size_t from, size_t step) {
+        // 8-byte big-endian keys, which nodes search through their packed heads
+        data.reserve(n_items);
+        for (size_t i = 0; i < n_items; ++i) {
+            const auto num = from + i * step;
+            spiderdb::key_encoder encoder;
+            encoder.add_uint64(num);
+            data.push_back({encoder.get(), spiderdb::value_pointer{static_cast<spiderdb::value_pointer::underlying_type>(num)}});
+        }
+    }
+
     void shuffle_data() {
         std::random_device rd;
         std::default_random_engine re{rd()};
@@ -866,4 +880,157 @@ SPIDERDB_FIXTURE_TEST_CASE(test_concurrent_requests, btree_test_fixture) {
     });
 }
 
+SPIDERDB_FIXTURE_TEST_CASE(test_concurrent_requests_with_splits_and_merges, btree_test_fixture) {
+    auto btree = fixture.btree;
+    auto generator = fixture.generator;
+    // Long keys fill a node with a few of them, so that adds split nodes and removes merge them all along
+    generator->generate_sequential_data(N_RECORDS, 0, LONG_KEY_LEN);
+    generator->shuffle_data();
+    // The first records of every three are found, the second ones removed and the third ones added
+    using it = boost::counting_iterator<size_t>;
+    return btree.open().then([btree, generator] {
+        return seastar::do_for_each(it{0}, it{N_RECORDS}, [btree, generator](size_t i) {
+            if (i % 3 == 2) {
+                return seastar::now();
+            }
+            const auto& record = generator->get_data()[i];
+            return btree.add(record.first.clone(), record.second);
+        });
+    }).then([btree, generator] {
+        return seastar::parallel_for_each(it{0}, it{N_RECORDS}, [btree, generator](size_t i) {
+            const auto& record = generator->get_data()[i];
+            switch (i % 3) {
+                case 0: {
+                    return btree.find(record.first.clone()).then([value_pointer{record.second}](auto res) {
+                        SPIDERDB_CHECK_MESSAGE(res == value_pointer, "Wrong result: Actual = {}, Expected = {}", res, value_pointer);
+                    });
+                }
+                case 1: {
+                    return btree.remove(record.first.clone()).then([value_pointer{record.second}](auto res) {
+                        SPIDERDB_CHECK_MESSAGE(res == value_pointer, "Wrong result: Actual = {}, Expected = {}", res, value_pointer);
+                    });
+                }
+                default: {
+                    return btree.add(record.first.clone(), record.second);
+                }
+            }
+        });
+    }).then([btree, generator] {
+        return seastar::do_for_each(it{0}, it{N_RECORDS}, [btree, generator](size_t i) {
+            const auto& record = generator->get_data()[i];
+            return btree.find(record.first.clone()).then_wrapped([i, value_pointer{record.second}](auto fut) {
+                if (i % 3 == 1) {
+                    SPIDERDB_REQUIRE(fut.failed());
+                    SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::key_not_exists);
+                } else {
+                    SPIDERDB_REQUIRE(!fut.failed());
+                    auto res = fut.get0();
+                    SPIDERDB_CHECK_MESSAGE(res == value_pointer, "Wrong result: Actual = {}, Expected = {}", res, value_pointer);
+                }
+            });
+        });
+    }).finally([btree, generator] {
+        return btree.close().finally([btree] {});
+    });
+}
+
+SPIDERDB_TEST_SUITE_END()
+
+SPIDERDB_TEST_SUITE(btree_test_fixed_width_keys)
+
+SPIDERDB_FIXTURE_TEST_CASE(test_find_records_with_fixed_width_key, btree_test_fixture) {
+    auto btree = fixture.btree;
+    auto generator = fixture.generator;
+    // Even numbers from 2 to 2 * N_RECORDS, so that 0 falls before every key, every odd number between two keys and
+    // 2 * N_RECORDS + 1 after every key
+    generator->generate_fixed_width_data(N_RECORDS, 2, 2);
+    generator->shuffle_data();
+    return btree.open().then([btree, generator] {
+        return seastar::do_for_each(generator->get_data(), [btree](auto record) {
+            return btree.add(std::move(record.first), record.second);
+        }).then([btree, generator] {
+            return seastar::parallel_for_each(generator->get_data(), [btree](auto record) {
+                return btree.find(std::move(record.first)).then([value_pointer{record.second}](auto res) {
+                    SPIDERDB_CHECK_MESSAGE(res == value_pointer, "Wrong result: Actual = {}, Expected = {}", res, value_pointer);
+                });
+            });
+        }).then([btree, generator] {
+            generator->clear_data();
+            generator->generate_fixed_width_data(N_RECORDS + 1, 1, 2);
+            generator->generate_fixed_width_data(1, 0, 1);
+            generator->shuffle_data();
+            return seastar::parallel_for_each(generator->get_data(), [btree](auto record) {
+                return btree.find(std::move(record.first)).then_wrapped([](auto fut) {
+                    SPIDERDB_REQUIRE(fut.failed());
+                    SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::key_not_exists);
+                });
+            });
+        });
+    }).finally([btree, generator] {
+        return btree.close().finally([btree] {});
+    });
+}
+
+SPIDERDB_TEST_SUITE_END()
+
+SPIDERDB_TEST_SUITE(btree_test_node_cache)
+
+SPIDERDB_FIXTURE_TEST_CASE(test_keep_hot_nodes_cached_during_scan, btree_test_fixture) {
+    spiderdb::spiderdb_config config;
+    config.max_keys_on_each_node = 1 << 5;
+    config.min_keys_on_each_node = 1 << 3;
+    config.n_cached_nodes = 1 << 7;
+    config.node_cache_policy = spiderdb::cache_policy::s3_fifo;
+    // Only leaves go through the node cache
+    config.pin_internal_nodes = true;
+    config.max_read_ahead_leaves = 1 << 2;
+    spiderdb::btree btree{DATA_FILE, config};
+    auto generator = fixture.generator;
+    generator->generate_sequential_data(N_SCANNED_RECORDS, 0, SHORT_KEY_LEN);
+    auto find = [btree, generator](size_t i) {
+        const auto& record = generator->get_data()[i];
+        return btree.find(record.first.clone()).then([value_pointer{record.second}](auto res) {
+            SPIDERDB_CHECK_MESSAGE(res == value_pointer, "Wrong result: Actual = {}, Expected = {}", res, value_pointer);
+        });
+    };
+    // Far apart, so that the hot records live in leaves that are never read ahead of each other
+    auto find_hot = [find](size_t i) {
+        return find(i % N_HOT_RECORDS * (N_SCANNED_RECORDS / N_HOT_RECORDS));
+    };
+    auto n_loaded_nodes = seastar::make_lw_shared<uint64_t>(0);
+    return btree.open().then([btree, generator] {
+        return seastar::do_for_each(generator->get_data(), [btree](const auto& record) {
+            return btree.add(record.first.clone(), record.second);
+        });
+    }).finally([btree] {
+        return btree.close().finally([btree] {});
+    }).then([btree, find, find_hot, n_loaded_nodes] {
+        using it = boost::counting_iterator<size_t>;
+        return btree.open().then([find_hot] {
+            // Accessed more than once, the hot leaves are kept in the main queue
+            return seastar::do_for_each(it{0}, it{3 * N_HOT_RECORDS}, find_hot);
+        }).then([btree, find] {
+            // Steps as long as the longest leaf access every scanned leaf once, and the read-ahead loads the others
+            const size_t step = btree.get_config().max_keys_on_each_node;
+            btree.start_sequential_scan();
+            return seastar::do_for_each(it{0}, it{N_SCANNED_RECORDS / step - 2}, [find, step](size_t i) {
+                return find(i * step);
+            }).then([find, step] {
+                // Walking the last leaves key by key leaves nothing for the read-ahead to load afterwards
+                return seastar::do_for_each(it{N_SCANNED_RECORDS - 2 * step}, it{N_SCANNED_RECORDS}, find);
+            }).finally([btree] {
+                btree.stop_sequential_scan();
+            });
+        }).then([btree, find_hot, n_loaded_nodes] {
+            *n_loaded_nodes = btree.get_loaded_node_count();
+            return seastar::do_for_each(it{0}, it{N_HOT_RECORDS}, find_hot);
+        }).then([btree, n_loaded_nodes] {
+            const auto n_reloaded_nodes = btree.get_loaded_node_count() - *n_loaded_nodes;
+            SPIDERDB_CHECK_MESSAGE(n_reloaded_nodes == 0, "Hot nodes evicted by the scan: {}", n_reloaded_nodes);
+        }).finally([btree] {
+            return btree.close().finally([btree] {});
+        });
+    });
+}
+
 SPIDERDB_TEST_SUITE_END()
\ No newline at end of file
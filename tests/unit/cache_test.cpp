@@ -509,4 +509,110 @@ SPIDERDB_TEST_CASE(test_concurrent_access) {
     });
 }
 
+SPIDERDB_TEST_CASE(test_s3_fifo_put_and_get) {
+    // Create cache
+    const size_t capacity = 256;
+    const auto cache_history = seastar::make_lw_shared<std::list<std::pair<int, int>>>();
+    auto evictor = [cache_history](const std::pair<int, int>& evicted_item) -> seastar::future<> {
+        cache_history->push_front(evicted_item);
+        return seastar::now();
+    };
+    const auto cache = seastar::make_lw_shared<spiderdb::s3_fifo_cache<int, int>>(capacity, std::move(evictor));
+
+    // Generate access pattern
+    const auto n_unique_items = 512;
+    const auto access_pattern = seastar::make_lw_shared(generate_consecutive_data<int, int>(n_unique_items, 0));
+
+    // Put items into cache
+    return seastar::do_for_each(*access_pattern, [cache](const auto& item) {
+        const auto& key = item.first;
+        const auto& value = item.second;
+        return cache->put(key, value);
+    }).then([cache, cache_history, capacity, n_unique_items] {
+        // Check result
+        SPIDERDB_REQUIRE(cache->size() == capacity);
+        SPIDERDB_REQUIRE(cache_history->size() == n_unique_items - capacity);
+        const auto items = cache->get_items();
+        return seastar::do_with(std::move(items), [cache](auto& items) {
+            // Get items from cache
+            return seastar::do_for_each(items, [cache](const auto& item) {
+                const auto& key = item.first;
+                const auto& value = item.second;
+                return cache->get(key).then_wrapped([&key, &value](auto fut) {
+                    SPIDERDB_REQUIRE_MESSAGE(!fut.failed(), "Key {} not found", key);
+                    SPIDERDB_REQUIRE_MESSAGE(fut.get0() == value, "Key {} has a different value", key);
+                });
+            });
+        });
+    });
+}
+
+SPIDERDB_TEST_CASE(test_s3_fifo_scan_resistance) {
+    // Create cache
+    const size_t capacity = 256;
+    auto evictor = [](const std::pair<int, int>& evicted_item) -> seastar::future<> {
+        return seastar::now();
+    };
+    const auto cache = seastar::make_lw_shared<spiderdb::s3_fifo_cache<int, int>>(capacity, std::move(evictor));
+
+    // Generate access pattern
+    const auto n_hot_items = 64;
+    const auto hot_items = seastar::make_lw_shared(generate_consecutive_data<int, int>(n_hot_items, 0));
+    const auto scanned_items = seastar::make_lw_shared(generate_consecutive_data<int, int>(capacity * 4, n_hot_items));
+
+    // Put and access hot items, then scan many items only once
+    return seastar::do_for_each(*hot_items, [cache](const auto& item) {
+        const auto& key = item.first;
+        const auto& value = item.second;
+        return cache->put(key, value).then([cache, &key] {
+            return cache->get(key).discard_result();
+        }).then([cache, &key] {
+            return cache->get(key).discard_result();
+        });
+    }).then([cache, scanned_items] {
+        return seastar::do_for_each(*scanned_items, [cache](const auto& item) {
+            const auto& key = item.first;
+            const auto& value = item.second;
+            return cache->put(key, value);
+        });
+    }).then([cache, hot_items, scanned_items] {
+        // Check result
+        return seastar::do_for_each(*hot_items, [cache](const auto& item) {
+            const auto& key = item.first;
+            return cache->get(key).then_wrapped([&key](auto fut) {
+                SPIDERDB_REQUIRE_MESSAGE(!fut.failed(), "Key {} evicted by the scan", key);
+            });
+        });
+    });
+}
+
+SPIDERDB_TEST_CASE(test_s3_fifo_clear) {
+    // Create cache
+    const size_t capacity = 256;
+    const auto cache_history = seastar::make_lw_shared<std::list<std::pair<int, int>>>();
+    auto evictor = [cache_history](const std::pair<int, int>& evicted_item) -> seastar::future<> {
+        cache_history->push_front(evicted_item);
+        return seastar::now();
+    };
+    const auto cache = seastar::make_lw_shared<spiderdb::s3_fifo_cache<int, int>>(capacity, std::move(evictor));
+
+    // Generate cache data
+    const auto cache_size = 128;
+    const auto cache_data = seastar::make_lw_shared(generate_consecutive_data<int, int>(cache_size, 0));
+
+    // Put items into cache
+    return seastar::do_for_each(*cache_data, [cache](const auto& item) {
+        const auto& key = item.first;
+        const auto& value = item.second;
+        return cache->put(key, value);
+    }).then([cache, cache_history, cache_size] {
+        // Clear cache
+        return cache->clear().then([cache, cache_history, cache_size] {
+            // Check result
+            SPIDERDB_REQUIRE(cache->empty());
+            SPIDERDB_REQUIRE(cache_history->size() == cache_size);
+        });
+    });
+}
+
 SPIDERDB_TEST_SUITE_END()
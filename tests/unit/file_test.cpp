@@ -7,6 +7,8 @@
 #include <spiderdb/util/error.h>
 #include <spiderdb/testing/test_case.h>
 #include <boost/iterator/counting_iterator.hpp>
+#include <fstream>
+#include <set>
 
 #define SPIDERDB_ASSERT_EQUAL(actual, expected) \
 try { \
@@ -27,6 +29,24 @@ spiderdb::string generate_data(char c = '0', size_t len = 1 << 16, const char* p
     return res;
 }
 
+const size_t SMALL_DATA_LEN = 1 << 10;
+
+using page_list = std::vector<std::pair<spiderdb::string, spiderdb::page_id>>;
+
+// Writes records that fit in one page each, one after another so that their pages are allocated in order
+seastar::future<page_list> write_small_records(spiderdb::file file, size_t n_records) {
+    auto data = seastar::make_lw_shared<page_list>();
+    using it = boost::counting_iterator<size_t>;
+    return seastar::do_for_each(it{0}, it{n_records}, [file, data](size_t i) {
+        auto str = generate_data(static_cast<char>('0' + i % 10), SMALL_DATA_LEN);
+        return file.write(str).then([data, str](auto page_id) {
+            data->push_back(std::make_pair(str, page_id));
+        });
+    }).then([data] {
+        return std::move(*data);
+    });
+}
+
 struct file_test_fixture {
     file_test_fixture() : file{DATA_FILE} {
         system(fmt::format("rm {}", DATA_FILE).c_str());
@@ -140,6 +160,30 @@ SPIDERDB_FIXTURE_TEST_CASE(test_multiple_files_open_and_close, file_test_fixture
     });
 }
 
+SPIDERDB_FIXTURE_TEST_CASE(test_one_file_open_with_different_format_version, file_test_fixture) {
+    auto file = fixture.file;
+    // The format version is the first field of the file header
+    auto set_format_version = [](uint32_t version) {
+        std::fstream stream{DATA_FILE, std::ios::in | std::ios::out | std::ios::binary};
+        stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    };
+    return file.open().then([file] {
+        return file.close();
+    }).then([file, set_format_version] {
+        set_format_version(spiderdb::file_header::format_version() + 1);
+        return file.open().then_wrapped([](auto fut) {
+            SPIDERDB_REQUIRE(fut.failed());
+            SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::file_format_mismatch);
+        });
+    }).then([file, set_format_version] {
+        // A failed open leaves the file free to be opened again
+        set_format_version(spiderdb::file_header::format_version());
+        return file.open().then([file] {
+            return file.close();
+        });
+    }).finally([file] {});
+}
+
 SPIDERDB_TEST_SUITE_END()
 
 SPIDERDB_TEST_SUITE(file_test_write)
@@ -403,3 +447,108 @@ SPIDERDB_FIXTURE_TEST_CASE(test_read_multiple_pages_concurrently, file_test_fixt
 }
 
 SPIDERDB_TEST_SUITE_END()
+
+SPIDERDB_TEST_SUITE(file_test_free_space)
+
+SPIDERDB_FIXTURE_TEST_CASE(test_reuse_freed_pages_after_reopening, file_test_fixture) {
+    auto file = fixture.file;
+    auto freed = seastar::make_lw_shared<std::set<spiderdb::page_id>>();
+    return file.open().then([file] {
+        return write_small_records(file, 32);
+    }).then([file, freed](auto data) {
+        for (const auto& item : data) {
+            freed->insert(item.second);
+        }
+        return seastar::do_for_each(*freed, [file](auto page_id) {
+            return file.unlink(page_id);
+        });
+    }).finally([file] {
+        return file.close().finally([file] {});
+    }).then([file, freed] {
+        return file.open().then([file] {
+            return write_small_records(file, 32);
+        }).then([freed](auto data) {
+            for (const auto& item : data) {
+                SPIDERDB_CHECK_MESSAGE(freed->count(item.second) > 0, "Page {} not reused", item.second);
+            }
+        }).finally([file] {
+            return file.close().finally([file] {});
+        });
+    });
+}
+
+SPIDERDB_FIXTURE_TEST_CASE(test_grow_file_by_chunks, file_test_fixture) {
+    spiderdb::spiderdb_config config;
+    config.file_growth_chunk_pages = 16;
+    spiderdb::file file{DATA_FILE, config};
+    auto first = seastar::make_lw_shared<spiderdb::page_id>(spiderdb::null_page);
+    return file.open().then([file] {
+        return write_small_records(file, 20);
+    }).then([first](auto data) {
+        // The second chunk continues the first one
+        *first = data.front().second;
+        for (size_t i = 0; i < data.size(); ++i) {
+            SPIDERDB_CHECK(data[i].second == *first + spiderdb::page_id{static_cast<int64_t>(i)});
+        }
+    }).finally([file] {
+        return file.close().finally([file] {});
+    }).then([file, first] {
+        return file.open().then([file] {
+            return write_small_records(file, 1);
+        }).then([first](auto data) {
+            // The rest of the second chunk is kept as free space across the reopen
+            SPIDERDB_CHECK(data.front().second == *first + spiderdb::page_id{20});
+        }).finally([file] {
+            return file.close().finally([file] {});
+        });
+    });
+}
+
+SPIDERDB_FIXTURE_TEST_CASE(test_reuse_punched_free_tail, file_test_fixture) {
+    spiderdb::spiderdb_config config;
+    config.file_growth_chunk_pages = 16;
+    config.punch_free_tail = true;
+    spiderdb::file file{DATA_FILE, config};
+    auto kept = seastar::make_lw_shared<page_list>();
+    auto freed = seastar::make_lw_shared<std::set<spiderdb::page_id>>();
+    return file.open().then([file] {
+        return write_small_records(file, 64);
+    }).then([kept](auto data) {
+        *kept = std::move(data);
+    }).finally([file] {
+        return file.close().finally([file] {});
+    }).then([file, freed] {
+        // These records come after the free space map, so freeing them leaves a free tail to punch
+        return file.open().then([file] {
+            return write_small_records(file, 64);
+        }).then([file, freed](auto data) {
+            for (const auto& item : data) {
+                freed->insert(item.second);
+            }
+            return seastar::do_for_each(*freed, [file](auto page_id) {
+                return file.unlink(page_id);
+            });
+        }).finally([file] {
+            return file.close().finally([file] {});
+        });
+    }).then([file, kept, freed] {
+        return file.open().then([file] {
+            return write_small_records(file, 64);
+        }).then([file, kept, freed](auto data) {
+            auto written = seastar::make_lw_shared<page_list>(std::move(data));
+            for (const auto& item : *written) {
+                SPIDERDB_CHECK_MESSAGE(freed->count(item.second) > 0, "Page {} not reused", item.second);
+            }
+            written->insert(written->end(), kept->begin(), kept->end());
+            return seastar::do_for_each(*written, [file](auto& item) {
+                return file.read(item.second).then([&item](auto res) {
+                    SPIDERDB_CHECK_MESSAGE(res == item.first, "Wrong result");
+                });
+            }).finally([written] {});
+        }).finally([file] {
+            return file.close().finally([file] {});
+        });
+    });
+}
+
+SPIDERDB_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#define SPIDERDB_USING_MASTER_TEST_SUITE
+#include <spiderdb/util/key_codec.h>
+#include <spiderdb/testing/test_case.h>
+#include <cstring>
+#include <limits>
+
+SPIDERDB_TEST_SUITE(key_codec_test)
+
+SPIDERDB_TEST_CASE(test_encode_key) {
+    { // Test order integers
+        auto encode = [](int64_t val) {
+            spiderdb::key_encoder encoder;
+            return encoder.add_int64(val).get();
+        };
+        SPIDERDB_CHECK(encode(std::numeric_limits<int64_t>::min()) < encode(-1));
+        SPIDERDB_CHECK(encode(-1) < encode(0));
+        SPIDERDB_CHECK(encode(0) < encode(1));
+        SPIDERDB_CHECK(encode(255) < encode(256));
+    }
+    { // Test order floating-point numbers
+        auto encode = [](double val) {
+            spiderdb::key_encoder encoder;
+            return encoder.add_double(val).get();
+        };
+        SPIDERDB_CHECK(encode(-2.5) < encode(-1.0));
+        SPIDERDB_CHECK(encode(-1.0) < encode(0.0));
+        SPIDERDB_CHECK(encode(0.0) < encode(0.5));
+        SPIDERDB_CHECK(encode(0.5) < encode(1e10));
+    }
+    { // Test order strings
+        auto encode = [](const char* data, size_t len) {
+            spiderdb::key_encoder encoder;
+            return encoder.add_string(spiderdb::string{data, len}).add_uint64(0).get();
+        };
+        SPIDERDB_CHECK(encode("a", 1) < encode("ab", 2));
+        SPIDERDB_CHECK(encode("a", 1) < encode("a\0", 2));
+        SPIDERDB_CHECK(encode("a\0", 2) < encode("a\1", 2));
+        SPIDERDB_CHECK(encode("ab", 2) < encode("b", 1));
+    }
+    { // Test order descending fields
+        auto encode = [](uint64_t tenant, uint64_t timestamp) {
+            spiderdb::key_encoder encoder;
+            return encoder.add_uint64(tenant).add_uint64(timestamp, spiderdb::key_order::descending).get();
+        };
+        SPIDERDB_CHECK(encode(1, 100) < encode(1, 10));
+        SPIDERDB_CHECK(encode(1, 10) < encode(2, 100));
+    }
+    return seastar::now();
+}
+
+SPIDERDB_TEST_CASE(test_decode_key) {
+    { // Decode a composite key
+        const char data[] = {'i', 'd', '\0', '1'};
+        spiderdb::key_encoder encoder;
+        encoder.add_uint64(7).add_int64(-42, spiderdb::key_order::descending).add_double(-0.25);
+        encoder.add_string(spiderdb::string{data, sizeof(data)}, spiderdb::key_order::descending);
+        auto key = encoder.get();
+        spiderdb::key_decoder decoder{key};
+        SPIDERDB_CHECK(decoder.get_uint64() == 7);
+        SPIDERDB_CHECK(decoder.get_int64(spiderdb::key_order::descending) == -42);
+        SPIDERDB_CHECK(decoder.get_double() == -0.25);
+        auto str = decoder.get_string(spiderdb::key_order::descending);
+        SPIDERDB_CHECK(str.length() == sizeof(data));
+        SPIDERDB_CHECK(memcmp(str.c_str(), data, sizeof(data)) == 0);
+        SPIDERDB_CHECK(decoder.empty());
+    }
+    { // Failed to decode a truncated key
+        spiderdb::key_encoder encoder;
+        auto key = encoder.add_string(spiderdb::string{"key"}).get();
+        spiderdb::key_decoder decoder{spiderdb::string{key.c_str(), key.length() - 1}};
+        try {
+            decoder.get_string();
+            SPIDERDB_REQUIRE(false);
+        } catch (std::invalid_argument& err) {
+            SPIDERDB_CHECK(strcmp(err.what(), "Key codec: Unterminated string") == 0);
+        }
+    }
+    return seastar::now();
+}
+
+SPIDERDB_TEST_SUITE_END()
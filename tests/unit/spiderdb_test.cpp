@@ -0,0 +1,113 @@
+//
+// Created by chungphb on 16/10/26.
+//
+
+#define SPIDERDB_USING_MASTER_TEST_SUITE
+#include <spiderdb/core/spiderdb.h>
+#include <spiderdb/util/hasher.h>
+#include <spiderdb/util/error.h>
+#include <spiderdb/testing/test_case.h>
+#include <seastar/core/smp.hh>
+#include <fstream>
+
+#define SPIDERDB_ASSERT_EQUAL(actual, expected) \
+try { \
+    std::rethrow_exception(actual); \
+} catch (spiderdb::spiderdb_error& err) { \
+    SPIDERDB_REQUIRE(err.get_error_code() == expected); \
+}
+
+namespace {
+
+const std::string DATA_FOLDER = "data";
+const std::string DATA_NAME = DATA_FOLDER + "/spiderdb_test";
+const std::string MANIFEST_FILE = DATA_NAME + ".manifest";
+
+// The manifest starts with the shard count, followed by the hasher id
+const size_t SHARD_COUNT_OFFSET = 0;
+const size_t HASHER_ID_OFFSET = sizeof(uint32_t);
+
+void patch_manifest(size_t offset, uint32_t val) {
+    std::fstream manifest{MANIFEST_FILE, std::ios::in | std::ios::out | std::ios::binary};
+    manifest.seekp(offset);
+    manifest.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+struct spiderdb_test_fixture {
+    spiderdb_test_fixture() : db{DATA_NAME} {
+        system(fmt::format("rm -f {}*", DATA_NAME).c_str());
+    }
+    ~spiderdb_test_fixture() = default;
+    spiderdb::spiderdb db;
+};
+
+}
+
+SPIDERDB_TEST_SUITE(spiderdb_test_manifest)
+
+SPIDERDB_FIXTURE_TEST_CASE(test_reopen_with_the_same_manifest, spiderdb_test_fixture) {
+    auto db = fixture.db;
+    return db.open().then([db] {
+        return db.insert(spiderdb::string{"key"}, spiderdb::string{"value"});
+    }).then([db] {
+        return db.close();
+    }).then([db] {
+        return db.open();
+    }).then([db] {
+        return db.select(spiderdb::string{"key"}).then([](auto value) {
+            SPIDERDB_CHECK(value == spiderdb::string{"value"});
+        });
+    }).finally([db] {
+        return db.close().finally([db] {});
+    });
+}
+
+SPIDERDB_FIXTURE_TEST_CASE(test_reopen_with_different_shard_count, spiderdb_test_fixture) {
+    auto db = fixture.db;
+    return db.open().then([db] {
+        return db.close();
+    }).then([db] {
+        patch_manifest(SHARD_COUNT_OFFSET, seastar::smp::count + 1);
+        return db.open().then_wrapped([](auto fut) {
+            SPIDERDB_REQUIRE(fut.failed());
+            SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::manifest_mismatch);
+        });
+    }).finally([db] {});
+}
+
+SPIDERDB_FIXTURE_TEST_CASE(test_reopen_with_different_hasher, spiderdb_test_fixture) {
+    auto db = fixture.db;
+    return db.open().then([db] {
+        return db.close();
+    }).then([db] {
+        patch_manifest(HASHER_ID_OFFSET, spiderdb::hasher_id + 1);
+        return db.open().then_wrapped([](auto fut) {
+            SPIDERDB_REQUIRE(fut.failed());
+            SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::manifest_mismatch);
+        });
+    }).finally([db] {});
+}
+
+SPIDERDB_FIXTURE_TEST_CASE(test_reopen_without_manifest, spiderdb_test_fixture) {
+    auto db = fixture.db;
+    return db.open().then([db] {
+        return db.close();
+    }).then([db] {
+        system(fmt::format("rm {}", MANIFEST_FILE).c_str());
+        return db.open().then_wrapped([](auto fut) {
+            SPIDERDB_REQUIRE(fut.failed());
+            SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::manifest_mismatch);
+        });
+    }).finally([db] {});
+}
+
+SPIDERDB_FIXTURE_TEST_CASE(test_open_next_to_unsharded_file, spiderdb_test_fixture) {
+    auto db = fixture.db;
+    system(fmt::format("touch {}", DATA_NAME).c_str());
+    return db.open().then_wrapped([](auto fut) {
+        SPIDERDB_REQUIRE(fut.failed());
+        SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::manifest_mismatch);
+    }).finally([db] {});
+}
+
+SPIDERDB_TEST_SUITE_END()
\ No newline at end of file
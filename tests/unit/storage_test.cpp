@@ -19,6 +19,7 @@ namespace {
 
 const std::string DATA_FOLDER = "data";
 const std::string DATA_FILE = DATA_FOLDER + "/test.dat";
+const std::string CRASH_FILE = DATA_FOLDER + "/crash.dat";
 
 uint8_t get_number_of_digits(size_t num) {
     uint8_t n_digits = 0;
@@ -1083,4 +1084,129 @@ SPIDERDB_FIXTURE_TEST_CASE(test_concurrent_requests, storage_test_fixture) {
     });
 }
 
+SPIDERDB_TEST_SUITE_END()
+
+SPIDERDB_TEST_SUITE(storage_test_recovery)
+
+SPIDERDB_FIXTURE_TEST_CASE(test_select_after_crash, storage_test_fixture) {
+    auto generator = fixture.generator;
+    generator->generate_sequential_data(N_RECORDS, 0, SHORT_KEY_LEN, SHORT_VALUE_LEN);
+    generator->shuffle_data();
+    // Without background checkpoints, the writes after the reopen only reach the log
+    spiderdb::spiderdb_config config;
+    config.writeback_interval = std::chrono::hours{1};
+    spiderdb::storage crashed{DATA_FILE, config};
+    const size_t half = N_RECORDS / 2;
+    using it = boost::counting_iterator<size_t>;
+    return crashed.open().then([crashed, generator, half] {
+        return seastar::parallel_for_each(it{0}, it{half}, [crashed, generator](auto i) {
+            const auto& record = generator->get_data()[i];
+            return crashed.insert(record.first.clone(), record.second.clone());
+        });
+    }).then([crashed] {
+        return crashed.close();
+    }).then([crashed] {
+        return crashed.open();
+    }).then([crashed, generator, half] {
+        // Erase a quarter, update another and insert the other half
+        return seastar::parallel_for_each(it{0}, it{N_RECORDS}, [crashed, generator, half](auto i) {
+            const auto& record = generator->get_data()[i];
+            if (i < half / 2) {
+                return crashed.erase(record.first.clone(), spiderdb::durability::synced);
+            }
+            if (i < half) {
+                return crashed.update(record.first.clone(), record.second + spiderdb::to_string(0), spiderdb::durability::synced);
+            }
+            return crashed.insert(record.first.clone(), record.second.clone(), spiderdb::durability::synced);
+        });
+    }).then([] {
+        // Copy the files as a crash would leave them. Nothing else runs during the copy, and the files of the crashed
+        // storage are never opened again.
+        system(fmt::format("rm -f {}*", CRASH_FILE).c_str());
+        system(fmt::format("for f in {0}*; do cp \"$f\" \"{1}${{f#{0}}}\"; done", DATA_FILE, CRASH_FILE).c_str());
+    }).then([generator, half] {
+        spiderdb::storage recovered{CRASH_FILE};
+        return recovered.open().then([recovered, generator, half] {
+            return seastar::parallel_for_each(it{0}, it{N_RECORDS}, [recovered, generator, half](auto i) {
+                const auto& record = generator->get_data()[i];
+                return recovered.select(record.first.clone()).then_wrapped([i, half, value{record.second}](auto fut) {
+                    if (i < half / 2) {
+                        SPIDERDB_REQUIRE(fut.failed());
+                        SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::key_not_exists);
+                    } else if (i < half) {
+                        SPIDERDB_CHECK(fut.get() == value + spiderdb::to_string(0));
+                    } else {
+                        SPIDERDB_CHECK(fut.get() == value);
+                    }
+                });
+            });
+        }).finally([recovered] {
+            return recovered.close().finally([recovered] {});
+        });
+    }).finally([crashed] {
+        return crashed.close().finally([crashed] {});
+    });
+}
+
+SPIDERDB_TEST_SUITE_END()
+
+SPIDERDB_TEST_SUITE(storage_test_bloom_filter)
+
+SPIDERDB_FIXTURE_TEST_CASE(test_select_update_and_erase_with_bloom_filter, storage_test_fixture) {
+    auto generator = fixture.generator;
+    generator->generate_sequential_data(N_RECORDS, 0, SHORT_KEY_LEN, SHORT_VALUE_LEN);
+    generator->shuffle_data();
+    spiderdb::spiderdb_config config;
+    config.bloom_filter_bits_per_key = 10;
+    spiderdb::storage storage{DATA_FILE, config};
+    const size_t half = N_RECORDS / 2;
+    using it = boost::counting_iterator<size_t>;
+    // A quarter is erased, another is updated, and the second half is never inserted
+    auto check_records = [generator, half](spiderdb::storage storage) {
+        return seastar::parallel_for_each(it{0}, it{N_RECORDS}, [storage, generator, half](auto i) {
+            const auto& record = generator->get_data()[i];
+            return storage.select(record.first.clone()).then_wrapped([i, half, value{record.second}](auto fut) {
+                if (i < half / 2 || i >= half) {
+                    SPIDERDB_REQUIRE(fut.failed());
+                    SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::key_not_exists);
+                } else {
+                    SPIDERDB_CHECK(fut.get() == value + spiderdb::to_string(0));
+                }
+            });
+        });
+    };
+    return storage.open().then([storage, generator, half] {
+        return seastar::parallel_for_each(it{0}, it{half}, [storage, generator](auto i) {
+            const auto& record = generator->get_data()[i];
+            return storage.insert(record.first.clone(), record.second.clone());
+        });
+    }).then([storage, generator, half] {
+        return seastar::parallel_for_each(it{0}, it{N_RECORDS}, [storage, generator, half](auto i) {
+            const auto& record = generator->get_data()[i];
+            auto write = (i < half / 2 || i >= half)
+                    ? storage.erase(record.first.clone())
+                    : storage.update(record.first.clone(), record.second + spiderdb::to_string(0));
+            return write.then_wrapped([i, half](auto fut) {
+                if (i >= half) {
+                    SPIDERDB_REQUIRE(fut.failed());
+                    SPIDERDB_ASSERT_EQUAL(fut.get_exception(), spiderdb::error_code::key_not_exists);
+                } else {
+                    SPIDERDB_REQUIRE(!fut.failed());
+                }
+            });
+        });
+    }).then([storage, check_records] {
+        return check_records(storage);
+    }).finally([storage] {
+        return storage.close().finally([storage] {});
+    }).then([storage, check_records] {
+        // The filter is loaded back from the file
+        return storage.open().then([storage, check_records] {
+            return check_records(storage);
+        }).finally([storage] {
+            return storage.close().finally([storage] {});
+        });
+    });
+}
+
 SPIDERDB_TEST_SUITE_END()
\ No newline at end of file
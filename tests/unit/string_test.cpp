@@ -224,6 +224,18 @@ SPIDERDB_TEST_CASE(test_compare_strings) {
         SPIDERDB_CHECK(!(str1 > str2));
         SPIDERDB_CHECK(str1 <= str2);
     }
+    { // Test compare bytes as unsigned
+        const char arr1[] = {'a', 'b'};
+        const char arr2[] = {'a', static_cast<char>(0x80)};
+        spiderdb::string str1{arr1, sizeof(arr1)};
+        spiderdb::string str2{arr2, sizeof(arr2)};
+
+        SPIDERDB_CHECK(str1.compare(str2) < 0);
+        SPIDERDB_CHECK(str2.compare(str1) > 0);
+        SPIDERDB_CHECK(str1.compare(str1.clone()) == 0);
+        SPIDERDB_CHECK(str1 < str2);
+        SPIDERDB_CHECK(!(str1 > str2));
+    }
     return seastar::now();
 }
 